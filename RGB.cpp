@@ -5,6 +5,9 @@
 #include <thread>
 #include <atomic>
 
+#define INCLUDE_FRAME_PACER
+#include <utils.h>
+
 constexpr int WINDOW_WIDTH = 600;
 constexpr int WINDOW_HEIGHT = 600;
 
@@ -50,8 +53,6 @@ SDL_Color next_color(SDL_Color prv) {
 std::atomic_int fps;
 std::atomic_bool request_exit = false;
 
-bool software_rendering = false;
-
 void fps_displayer() {
 	fps = 0;
 	while(!request_exit) {
@@ -69,21 +70,16 @@ int main(int, char **) {
 	}
 
 	SDL_Window *window = SDL_CreateWindow("test", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
-	SDL_Renderer *render = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
 	if(!window) {
 		fprintf(stderr, "%s\n", SDL_GetError());
 		return 2;
 	}
 
+	FramePacer pacer(FramePacer::Mode::VSYNC);
+	SDL_Renderer *render = pacer.create_renderer(window);
 	if(!render) {
 		fprintf(stderr, "%s\n", SDL_GetError());
-
-		render = SDL_CreateSoftwareRenderer(SDL_GetWindowSurface(window));
-		software_rendering = true;
-		if(!render) {
-			fprintf(stderr, "%s\n", SDL_GetError());
-			return 3;
-		}
+		return 3;
 	}
 
 	std::thread t(fps_displayer);
@@ -101,15 +97,13 @@ int main(int, char **) {
 
 		SDL_RenderFillRect(render, nullptr);
 
-		if (software_rendering) {
-			SDL_UpdateWindowSurface(window);
-		} else {
-			SDL_RenderPresent(render);
-		}
+		pacer.present();
 
 		++fps;
 
 		color = next_color(color);
+
+		pacer.wait();
 	}
 
 	SDL_DestroyRenderer(render);
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <utils.h>
+
+/*
+ * Measure how many command line tokens per second ArgumentProcessor::process() gets through,
+ * with more and more options registered, on command lines of options, their sub parameters and
+ * positional arguments, some of which start with '-' without being options.
+ * Build it with INCLUDE_ARGUMENT defined and run it like:
+ *     ./argument_benchmark
+ */
+
+using std::cout;
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t OPTION_COUNTS[] = {10, 100, 500};
+constexpr size_t TOKENS = 100000;
+constexpr auto DURATION = std::chrono::milliseconds(500); // Per measurement
+
+/*
+ * The names of option i: a long one, and every third one a short one too.
+ */
+std::vector<std::string> option_names(size_t i) {
+	std::vector<std::string> names = {"--option-" + std::to_string(i)};
+	if(i % 3 == 0) names.push_back("-o" + std::to_string(i));
+	return names;
+}
+
+int main() {
+	cout << std::setw(10) << "options" << std::setw(10) << "tokens" << std::setw(20) << "tokens/s" << std::setw(12) << "calls" << '\n';
+	for(size_t options : OPTION_COUNTS) {
+		ArgumentProcessor ap;
+		size_t calls = 0;
+		for(size_t i = 0; i < options; ++i) {
+			Argument arg;
+			for(const std::string &name : option_names(i)) arg.add_name(name);
+			arg.set_argc(i % 2).set_called_limit(SIZE_MAX).set_act_func([&calls](char **) {++calls;});
+			ap.register_argument(arg);
+		}
+		Argument positional;
+		positional.add_name("FILE").set_argc(1).set_called_limit(SIZE_MAX).set_act_func([&calls](char **) {++calls;});
+		ap.register_argument(positional);
+		ap.set_default_argument(positional);
+
+		// Options with their sub parameters, and positional arguments, mixed
+		std::mt19937 engine(0);
+		std::vector<std::string> tokens = {"argument_benchmark"};
+		while(tokens.size() < TOKENS) {
+			const size_t kind = engine() % 4;
+			if(kind == 0) {
+				tokens.push_back(engine() % 2 ? "file" + std::to_string(engine() % 1000) : "-" + std::to_string(engine() % 1000));
+				continue;
+			}
+			const size_t i = engine() % options;
+			const std::vector<std::string> names = option_names(i);
+			tokens.push_back(names[engine() % names.size()]);
+			if(i % 2) tokens.push_back(std::to_string(engine()));
+		}
+		std::vector<char *> argv;
+		for(std::string &token : tokens) argv.push_back(token.data());
+
+		size_t processed = 0;
+		const auto start = Clock::now();
+		auto now = start;
+		while(now - start < DURATION) {
+			calls = 0;
+			if(!ap.process(argv.size(), argv.data())) return 1;
+			processed += argv.size();
+			now = Clock::now();
+		}
+		cout << std::setw(10) << options << std::setw(10) << argv.size() << std::fixed << std::setprecision(0)
+			<< std::setw(20) << processed / std::chrono::duration<double>(now - start).count() << std::setw(12) << calls << '\n';
+	}
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <utils.h>
+#include <console.h>
+
+/*
+ * Compare the bytes emitted per frame by console::Screen with the old per-cell approach,
+ * where every changed cell gets its own cursor movement and color escape, as output_map_soft did.
+ * Frames are written to stdout and the report goes to stderr, so run it like:
+ *     ./console_screen_benchmark > /dev/null
+ */
+
+using std::cerr;
+using console::ColorEnum;
+
+constexpr Area BOARD_AREA = {20, 15}; // The default map of console_snake
+constexpr uint_type CELL_WIDTH = 2;
+constexpr size_t FRAMES = 1000;
+constexpr ColorEnum COLORS[] = {ColorEnum::DEFAULT, ColorEnum::RED, ColorEnum::GREEN, ColorEnum::BLUE};
+
+/*
+ * Bytes the per-cell approach emits to redraw one board cell.
+ */
+size_t per_cell_bytes(UCoord c, ColorEnum color) {
+	std::string s = "\033[" + std::to_string(c.y + 1) + ';' + std::to_string(c.x * CELL_WIDTH + 1) + 'H';
+	s += color == ColorEnum::DEFAULT ? "\033[0m" : "\033[41m";
+	s.append(CELL_WIDTH, ' ');
+	return s.size();
+}
+
+int main() {
+	std::mt19937 engine(0);
+	std::uniform_int_distribution<uint_type> random_x(0, BOARD_AREA.w - 1), random_y(0, BOARD_AREA.h - 1);
+	std::uniform_int_distribution<size_t> random_color(0, std::size(COLORS) - 1);
+
+	cerr << std::setw(16) << "changes/frame" << std::setw(16) << "per-cell B" << std::setw(16) << "Screen B" << std::setw(16) << "per-cell calls" << std::setw(16) << "Screen calls" << '\n';
+	for(size_t changes : {1, 4, 16, 64, 300}) {
+		console::Screen screen({BOARD_AREA.w * CELL_WIDTH, BOARD_AREA.h});
+		std::vector<ColorEnum> board(BOARD_AREA.w * BOARD_AREA.h, ColorEnum::DEFAULT), old_board = board;
+		screen.present();
+
+		size_t per_cell_total = 0, per_cell_calls = 0, screen_total = 0, screen_calls = 0;
+		for(size_t frame = 0; frame < FRAMES; ++frame) {
+			for(size_t i = 0; i < changes; ++i) {
+				const UCoord c = {random_x(engine), random_y(engine)};
+				ColorEnum &color = board[c.y * BOARD_AREA.w + c.x];
+				color = COLORS[random_color(engine)];
+				for(uint_type x = 0; x < CELL_WIDTH; ++x) {
+					screen[{c.x * CELL_WIDTH + x, c.y}].back = color;
+				}
+			}
+			UCoord c;
+			for(c.y = 0; c.y < BOARD_AREA.h; ++c.y) {
+				for(c.x = 0; c.x < BOARD_AREA.w; ++c.x) {
+					const ColorEnum color = board[c.y * BOARD_AREA.w + c.x];
+					if(color == old_board[c.y * BOARD_AREA.w + c.x]) continue;
+					per_cell_total += per_cell_bytes(c, color);
+					per_cell_calls += 3; // Cursor movement, color and text were flushed separately.
+				}
+			}
+			old_board = board;
+			per_cell_total += 4 + 7; // Reset the color and move the cursor below the board.
+			per_cell_calls += 2;
+
+			const size_t written = screen.present();
+			screen_total += written;
+			screen_calls += written != 0;
+		}
+		cerr << std::setw(16) << changes
+			<< std::setw(16) << per_cell_total / FRAMES
+			<< std::setw(16) << screen_total / FRAMES
+			<< std::setw(16) << double(per_cell_calls) / FRAMES
+			<< std::setw(16) << double(screen_calls) / FRAMES << '\n';
+	}
+	return 0;
+}
@@ -15,9 +15,7 @@
 #include "utils.h"
 
 using console::ColorEnum;
-using console::ArrowKeyPraser;
 using console::color_reset;
-using console::cursor_gotoxy;
 using console::screen_clear;
 using namespace std::chrono;
 
@@ -57,6 +55,7 @@ Key key_from_console_key(console::Key k) {
 		case console::Key::UP: return Key::UP;
 		case console::Key::LEFT: return Key::LEFT;
 		case console::Key::RIGHT: return Key::RIGHT;
+		default: break;
 	}
 	return Key::UP; // avoid warning
 }
@@ -72,7 +71,6 @@ constexpr Direction operator!(Direction dir) {
 }
 
 constexpr size_t BLOCK_SPACE_WIDTH = 2;
-constexpr char BLOCK_TEXT[BLOCK_SPACE_WIDTH + 1]{"  "};
 
 constexpr ColorEnum HEAD_COLOR = ColorEnum::BLUE;
 constexpr ColorEnum BODY_COLOR = ColorEnum::CYAN;
@@ -81,6 +79,7 @@ constexpr auto DEFAULT_INITIAL_PAUSE_TIME = microseconds(1000 * 500);
 constexpr auto DEFAULT_MINIMAL_PAUSE_TIME = microseconds(1000 * 100);
 constexpr auto DEFAULT_PAUSE_TIME_REDUCTION = microseconds(1000 * 5);
 constexpr Area DEFAULT_MAP_AREA = {20, 15};
+constexpr uint_type MINIMAL_SCREEN_WIDTH = 20; // Leave room for the score
 
 auto initial_pause_time = DEFAULT_INITIAL_PAUSE_TIME;
 auto minimal_pause_time = DEFAULT_MINIMAL_PAUSE_TIME;
@@ -262,25 +261,19 @@ private:
 	volatile bool running;
 
 	void thrd_func() const {
-		ArrowKeyPraser arrow_key_praser;
+		console::Keyboard keyboard;
 		while(running) {
-			unsigned char c = getch([]() -> unsigned char {return cin.get();});
-			c = toupper(c);
-			if(!running) break;
-			auto result = arrow_key_praser(c);
-			switch(result.first) {
-				case console::ArrowKeyPraser::Status::MATCH:
-					callback(key_from_console_key(result.second));
+			std::optional<console::KeyPress> press = keyboard.read();
+			if(!press || !running) break;
+			switch(press->key) {
+				case console::Key::UP: case console::Key::DOWN: case console::Key::LEFT: case console::Key::RIGHT:
+					callback(key_from_console_key(press->key));
 					continue;
-					break;
-				case console::ArrowKeyPraser::Status::MATCHING:
-					continue;
-					break;
-				case console::ArrowKeyPraser::Status::MISMATCH:
-					break;
+				case console::Key::CHARACTER: break;
+				default: continue;
 			}
 
-			switch(c) { //wasd and hjkl keys
+			switch(press->character < 0x80 ? toupper(int(press->character)) : 0) { //wasd and hjkl keys
 				case 'W': case 'K': callback(Key::UP); break;
 				case 'S': case 'J': callback(Key::DOWN); break;
 				case 'A': case 'H': callback(Key::LEFT); break;
@@ -293,73 +286,54 @@ private:
 };
 
 Map map(map_area);
-MapReader reader, buffer_reader;
+MapReader reader;
+unique_ptr<console::Screen> screen;
 bool enable_output_map_soft = true;
 
-void output_ground() {
-	cout << "-";
-	for(uint_type i = 0; i < map_area.w; ++i) {
-		for(size_t j = 0; j < BLOCK_SPACE_WIDTH; ++j) cout << "-";
-	}
-	cout << "-";
-	cout << endl;
-}
-
-void output_field(Field f) {
-	switch(f) {
-		case Field::HEAD:
-			background_color(HEAD_COLOR);
-			break;
-		case Field::BODY:
-			background_color(BODY_COLOR);
-			break;
-		case Field::FOOD:
-			background_color(FOOD_COLOR);
-			break;
-		case Field::EMPTY:
-			color_reset();
-			for(uint_type i = 0; i < BLOCK_SPACE_WIDTH - 1; ++i) cout << ' ';
-			cout << '.' << flush;
-			return;
-			break;
-	}
-	cout << BLOCK_TEXT << flush;
-}
-
-void output_map() {
-	cursor_gotoxy({0, 0});
+/*
+ * Draw the map, its borders and the score on the back buffer of screen.
+ */
+void draw_map() {
+	constexpr char GROUND = '-', WALL = '|';
 	reader.generate(map);
-	buffer_reader.generate(map);
 
-	UCoord coord;
-	output_ground();
-	for(coord.y = 0; coord.y < map_area.h; ++coord.y) {
-		cout << "|";
-		for(coord.x = 0; coord.x < map_area.w; ++coord.x) {
-			output_field(reader[coord]);
-		}
-		color_reset();
-		cout << "|\n";
+	const Area screen_area = screen->size();
+	screen->fill();
+	for(uint_type x = 0; x < map_area.w * BLOCK_SPACE_WIDTH + 2; ++x) {
+		(*screen)[{x, 0}].glyph = GROUND;
+		(*screen)[{x, map_area.h + 1}].glyph = GROUND;
 	}
-	output_ground();
-	cout << "Score: " << map.score() << endl;
-}
-void output_map_soft() {
-	reader.generate(map);
-
 	UCoord coord;
 	for(coord.y = 0; coord.y < map_area.h; ++coord.y) {
+		(*screen)[{0, coord.y + 1}].glyph = WALL;
+		(*screen)[{map_area.w * BLOCK_SPACE_WIDTH + 1, coord.y + 1}].glyph = WALL;
 		for(coord.x = 0; coord.x < map_area.w; ++coord.x) {
-			if(reader[coord] != buffer_reader[coord]) {
-				cursor_gotoxy(UCoord{coord.x * 2 + 1, coord.y + 1});
-				output_field(reader[coord]);
+			console::Cell cell;
+			switch(reader[coord]) {
+				case Field::HEAD: cell.back = HEAD_COLOR; break;
+				case Field::BODY: cell.back = BODY_COLOR; break;
+				case Field::FOOD: cell.back = FOOD_COLOR; break;
+				case Field::EMPTY: break;
+			}
+			for(size_t i = 0; i < BLOCK_SPACE_WIDTH; ++i) {
+				(*screen)[{coord.x * BLOCK_SPACE_WIDTH + 1 + i, coord.y + 1}] = cell;
+			}
+			if(reader[coord] == Field::EMPTY) {
+				(*screen)[{(coord.x + 1) * BLOCK_SPACE_WIDTH, coord.y + 1}].glyph = '.';
 			}
 		}
 	}
-	cursor_gotoxy({0, map_area.h + 2});
-	color_reset();
-	cout << "Score: " << map.score() << endl;
-	buffer_reader.generate(map);
+	screen->print({0, screen_area.h - 1}, "Score: " + std::to_string(map.score()));
+}
+
+void output_map() {
+	draw_map();
+	screen->invalidate();
+	screen->present();
+}
+void output_map_soft() {
+	draw_map();
+	screen->present();
 }
 
 bool process_argument(int argc, char **argv) {
@@ -413,7 +387,10 @@ int main(int argc, char **argv) {
 	if(!process_argument(argc, argv)) {
 		return 1;
 	}
-	screen_clear();
+	screen.reset(new console::Screen({
+		std::max<uint_type>(map_area.w * BLOCK_SPACE_WIDTH + 2, MINIMAL_SCREEN_WIDTH),
+		map_area.h + 3 // Two for grounds and one for the score
+	}));
 	bool request_stop = false;
 	map.resize(map_area);
 	map.initialize();
@@ -434,7 +411,11 @@ int main(int argc, char **argv) {
 	event.start();
 	size_t score = 0;
 	auto pause_time = initial_pause_time;
-	output_map();
+	{
+		console::Batch batch; // Clear the terminal along with the first frame
+		screen_clear();
+		output_map();
+	}
 	auto output_func = output_map_soft;
 	if(!enable_output_map_soft) output_func = output_map;
 	while(!request_stop) {
@@ -452,6 +433,7 @@ int main(int argc, char **argv) {
 		}
 		delay(pause_time);
 	}
+	console::Batch batch;
 	color_reset();
 	cout << "Final Score: " << map.score() << ". Press any key to exit..." << endl;
 	return 0;
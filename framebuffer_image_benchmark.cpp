@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include <utils.h>
+
+/*
+ * Measure the milliseconds it takes to draw an image stretched over the whole of a framebuffer, as a wallpaper
+ * is: interpolated in floating point with a set() per pixel, by blit_scaled() with each filter, and converted
+ * once by convert() then copied by blit(), as ImageCache does. Without a device, an offscreen framebuffer
+ * of 1920x1080 is measured instead. Build it with INCLUDE_FRAMEBUFFER defined and run it like:
+ *     ./framebuffer_image_benchmark [/dev/fb0]
+ */
+
+using std::cout;
+using Clock = std::chrono::steady_clock;
+
+constexpr auto DURATION = std::chrono::milliseconds(500); // Per measurement
+constexpr Area OFFSCREEN_AREA = {1920, 1080};
+constexpr Area IMAGE_AREAS[] = {{640, 360}, {1280, 720}, {3840, 2160}};
+
+/*
+ * Opaque, with something different in every pixel.
+ */
+Image pattern(Area size) {
+	Image image(size);
+	for(uint_type y = 0; y < size.h; ++y) {
+		for(uint_type x = 0; x < size.w; ++x) {
+			image.set({x, y}, {uint8_t(x * 255 / size.w), uint8_t(y * 255 / size.h), uint8_t((x ^ y) & 0xff), 255});
+		}
+	}
+	return image;
+}
+
+/*
+ * image stretched over dest a pixel at a time, with bilinear interpolation in double.
+ */
+void draw_by_pixels(Framebuffer &fb, const Image &image, URect dest) {
+	const auto channel = [&image](uint_type x, uint_type y, int shift) {
+		return double(image.pixels[y * image.size.w + x] >> shift & 0xff);
+	};
+	for(uint_type y = 0; y < dest.area.h; ++y) {
+		const double source_y = std::clamp((y + 0.5) * image.size.h / dest.area.h - 0.5, 0.0, double(image.size.h - 1));
+		const uint_type y0 = source_y, y1 = std::min(y0 + 1, image.size.h - 1);
+		const double fy = source_y - y0;
+		for(uint_type x = 0; x < dest.area.w; ++x) {
+			const double source_x = std::clamp((x + 0.5) * image.size.w / dest.area.w - 0.5, 0.0, double(image.size.w - 1));
+			const uint_type x0 = source_x, x1 = std::min(x0 + 1, image.size.w - 1);
+			const double fx = source_x - x0;
+			uint8_t c[3];
+			for(int i = 0; i < 3; ++i) {
+				const int shift = 16 - 8 * i;
+				const double top = channel(x0, y0, shift) * (1 - fx) + channel(x1, y0, shift) * fx;
+				const double bottom = channel(x0, y1, shift) * (1 - fx) + channel(x1, y1, shift) * fx;
+				c[i] = static_cast<uint8_t>(std::lround(top * (1 - fy) + bottom * fy));
+			}
+			fb.set({dest.coord.x + x, dest.coord.y + y}, {c[0], c[1], c[2], 255});
+		}
+	}
+}
+
+/*
+ * Milliseconds draw takes on average.
+ */
+template<typename Function>
+double milliseconds(Framebuffer &fb, Function draw) {
+	size_t times = 0;
+	const auto start = Clock::now();
+	auto now = start;
+	while(now - start < DURATION) {
+		draw();
+		fb.reset_buffer();
+		++times;
+		now = Clock::now();
+	}
+	return std::chrono::duration<double, std::milli>(now - start).count() / times;
+}
+
+int main(int argc, char **argv) {
+	try {
+		Framebuffer fb = argc > 1 ? Framebuffer(argv[1]) : Framebuffer::offscreen(OFFSCREEN_AREA);
+		const URect screen = {{0, 0}, fb.size()};
+		cout << "Milliseconds to draw an image over " << fb.size().w << 'x' << fb.size().h << "\n";
+		cout << std::setw(12) << "image" << std::setw(12) << "set()" << std::setw(12) << "nearest"
+			<< std::setw(12) << "bilinear" << std::setw(12) << "convert()" << std::setw(12) << "cached" << '\n';
+		for(Area area : IMAGE_AREAS) {
+			const Image image = pattern(area);
+			const double by_pixels = milliseconds(fb, [&] {draw_by_pixels(fb, image, screen);});
+			const double nearest = milliseconds(fb, [&] {fb.blit_scaled(image, screen, ScaleFilter::NEAREST, BlendMode::REPLACE);});
+			const double bilinear = milliseconds(fb, [&] {fb.blit_scaled(image, screen, ScaleFilter::BILINEAR, BlendMode::REPLACE);});
+			NativeImage native;
+			const double converting = milliseconds(fb, [&] {native = fb.convert(image, screen.area);});
+			const double cached = milliseconds(fb, [&] {fb.blit(native, screen.coord);});
+			cout << std::setw(12) << std::to_string(area.w) + 'x' + std::to_string(area.h) << std::fixed << std::setprecision(2)
+				<< std::setw(12) << by_pixels << std::setw(12) << nearest << std::setw(12) << bilinear
+				<< std::setw(12) << converting << std::setw(12) << cached << '\n';
+		}
+	} catch(const FramebufferError &e) {
+		std::cerr << "Cannot open the framebuffer: " << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
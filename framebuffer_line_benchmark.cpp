@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <numbers>
+#include <vector>
+
+#include <utils.h>
+
+/*
+ * Measure lines per second drawn on a framebuffer at several lengths and angles:
+ * the old floating point draw_line with a set() per pixel, Bresenham's draw_line, the same lines
+ * batched through draw_lines(), and Wu's antialiased lines. Nothing is shown, so it can run on
+ * the console of the machine being measured. Without a device, an offscreen framebuffer of 1920x1080
+ * is measured instead. Build it with INCLUDE_FRAMEBUFFER defined and run it like:
+ *     ./framebuffer_line_benchmark [/dev/fb0]
+ */
+
+using std::cout;
+using Clock = std::chrono::steady_clock;
+
+constexpr double ANGLES[] = {0, 15, 30, 45, 60, 75, 90}; // Degrees
+constexpr uint_type LENGTHS[] = {10, 100, 1000};
+constexpr auto DURATION = std::chrono::milliseconds(200); // Per measurement
+constexpr Area OFFSCREEN_AREA = {1920, 1080};
+
+/*
+ * draw_line as it used to be: floor and ceil per column, and a pixel at a time.
+ */
+void old_draw_line(Framebuffer &fb, UCoord c1, UCoord c2, Color color) {
+	const auto column = [&fb, color](uint_type x, uint_type y, uint_type h) {
+		for(uint_type i = 0; i < h; ++i) fb.set({x, y + i}, color);
+	};
+	if(c1.x == c2.x) {
+		if(c2.y < c1.y) std::swap(c1.y, c2.y);
+		column(c1.x, c1.y, c2.y - c1.y + 1);
+		return;
+	}
+	if(c1.x > c2.x) std::swap(c1, c2);
+	const double width = c2.x - c1.x + 1;
+	if(c1.y > c2.y) {
+		const uint_type height = c1.y - c2.y + 1;
+		for(uint_type x = c1.x; x <= c2.x; ++x) {
+			const uint_type y1 = c1.y - static_cast<uint_type>(std::floor((x - c1.x) * height / width));
+			const uint_type y2 = c1.y - static_cast<uint_type>(std::ceil((x + 1 - c1.x) * height / width));
+			column(x, y2, y1 - y2);
+		}
+	} else if(c1.y < c2.y) {
+		const uint_type height = c2.y - c1.y + 1;
+		for(uint_type x = c1.x; x <= c2.x; ++x) {
+			const uint_type y1 = c1.y + static_cast<uint_type>(std::floor((x - c1.x) * height / width));
+			const uint_type y2 = c1.y + static_cast<uint_type>(std::ceil((x + 1 - c1.x) * height / width));
+			column(x, y1, y2 - y1);
+		}
+	} else {
+		for(uint_type x = c1.x; x <= c2.x; ++x) fb.set({x, c1.y}, color);
+	}
+}
+
+/*
+ * Lines of the given length and angle, fanned out over the screen so that they fit.
+ */
+std::vector<std::pair<UCoord, UCoord>> make_lines(Area screen, uint_type length, double angle) {
+	const double radians = angle * std::numbers::pi / 180;
+	const Area extent = {
+		static_cast<uint_type>(std::lround(length * std::cos(radians))),
+		static_cast<uint_type>(std::lround(length * std::sin(radians)))};
+	std::vector<std::pair<UCoord, UCoord>> lines;
+	if(extent.w >= screen.w || extent.h >= screen.h) return lines;
+	for(uint_type i = 0; i < 256; ++i) {
+		const UCoord start = {i * 7919 % (screen.w - extent.w), i * 104729 % (screen.h - extent.h)};
+		lines.push_back({start, {start.x + extent.w, start.y + extent.h}});
+	}
+	return lines;
+}
+
+/*
+ * Lines per second drawn by draw, which draws all of lines once per call.
+ */
+template<typename Function>
+double lines_per_second(Framebuffer &fb, const std::vector<std::pair<UCoord, UCoord>> &lines, Function draw) {
+	size_t drawn = 0;
+	const auto start = Clock::now();
+	auto now = start;
+	while(now - start < DURATION) {
+		draw();
+		fb.reset_buffer();
+		drawn += lines.size();
+		now = Clock::now();
+	}
+	return drawn / std::chrono::duration<double>(now - start).count();
+}
+
+int main(int argc, char **argv) {
+	try {
+		Framebuffer fb = argc > 1 ? Framebuffer(argv[1]) : Framebuffer::offscreen(OFFSCREEN_AREA);
+		const Color color = {255, 255, 255, 255};
+		cout << "Lines per second on " << fb.size().w << 'x' << fb.size().h << "\n";
+		cout << std::setw(8) << "length" << std::setw(8) << "angle" << std::setw(14) << "old" << std::setw(14) << "bresenham"
+			<< std::setw(14) << "draw_lines" << std::setw(14) << "wu" << '\n';
+		for(uint_type length : LENGTHS) {
+			for(double angle : ANGLES) {
+				const auto lines = make_lines(fb.size(), length, angle);
+				if(lines.empty()) continue;
+				const double old = lines_per_second(fb, lines, [&] {
+					for(const auto &[c1, c2] : lines) old_draw_line(fb, c1, c2, color);
+				});
+				const double bresenham = lines_per_second(fb, lines, [&] {
+					for(const auto &[c1, c2] : lines) fb.draw_line(c1, c2, color);
+				});
+				const double batched = lines_per_second(fb, lines, [&] {fb.draw_lines(lines, color);});
+				const double wu = lines_per_second(fb, lines, [&] {
+					for(const auto &[c1, c2] : lines) fb.draw_line_antialiased(c1, c2, color);
+				});
+				cout << std::setw(8) << length << std::setw(8) << angle << std::fixed << std::setprecision(0)
+					<< std::setw(14) << old << std::setw(14) << bresenham << std::setw(14) << batched << std::setw(14) << wu << '\n';
+			}
+		}
+	} catch(const FramebufferError &e) {
+		std::cerr << "Cannot open the framebuffer: " << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
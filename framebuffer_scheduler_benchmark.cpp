@@ -0,0 +1,98 @@
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+
+#include <utils.h>
+
+/*
+ * Measure how a FrameScheduler paces an animation on a framebuffer: frames per second, frames missed
+ * and the share of a core taken, next to the same animation drawn and updated as fast as possible.
+ * The slow animation takes one and a half periods per frame, to be seen missing frames.
+ * Without a device, an offscreen framebuffer of 1920x1080 is paced by a timer instead.
+ * Build it with INCLUDE_FRAMEBUFFER defined and run it like:
+ *     ./framebuffer_scheduler_benchmark [/dev/fb0]
+ */
+
+using std::cout;
+using Clock = std::chrono::steady_clock;
+
+constexpr auto DURATION = std::chrono::seconds(2); // Per measurement
+constexpr Area OFFSCREEN_AREA = {1920, 1080};
+constexpr Area BOX_AREA = {100, 100};
+
+/*
+ * A box moving across the screen, one step per frame.
+ */
+void draw_frame(Framebuffer &fb, uint64_t frame) {
+	const Area screen = fb.size();
+	fb.fill({0, 0, 0, 255});
+	fb.fill_rectangle({frame * 8 % (screen.w - BOX_AREA.w), screen.h / 2}, BOX_AREA, {255, 200, 0, 255});
+}
+
+/*
+ * Keep the processor busy until seconds have passed since start.
+ */
+void busy_until(Clock::time_point start, double seconds) {
+	while(std::chrono::duration<double>(Clock::now() - start).count() < seconds) {}
+}
+
+struct Result {
+	uint64_t frames, missed;
+	double fps, cpu; // cpu as a share of a core
+};
+
+/*
+ * Run frames through draw until DURATION has passed, paced by scheduler unless it's nullptr.
+ */
+template<typename Function>
+Result measure(Framebuffer &fb, FrameScheduler *scheduler, Function draw) {
+	const std::clock_t cpu_start = std::clock();
+	const auto start = Clock::now();
+	const uint64_t frames_before = scheduler ? scheduler->frames() : 0, missed_before = scheduler ? scheduler->missed() : 0;
+	uint64_t frames = 0;
+	while(Clock::now() - start < DURATION) {
+		draw(frames);
+		if(scheduler) {
+			scheduler->present();
+		} else {
+			fb.update();
+		}
+		++frames;
+	}
+	const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	const double cpu = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+	return {
+		frames,
+		scheduler ? scheduler->missed() - missed_before : 0,
+		(scheduler ? scheduler->frames() - frames_before : frames) / seconds,
+		cpu / seconds,
+	};
+}
+
+void print(const char *name, const Result &result) {
+	cout << std::setw(12) << name << std::setw(10) << result.frames << std::fixed << std::setprecision(1)
+		<< std::setw(10) << result.fps << std::setw(10) << result.missed << std::setw(9) << result.cpu * 100 << "%\n";
+}
+
+int main(int argc, char **argv) {
+	try {
+		Framebuffer fb = argc > 1 ? Framebuffer(argv[1]) : Framebuffer::offscreen(OFFSCREEN_AREA);
+		FrameScheduler scheduler(fb);
+		cout << "Frames on " << fb.size().w << 'x' << fb.size().h << ", paced by " << (scheduler.vsync() ? "vsync" : "a timer")
+			<< " every " << std::fixed << std::setprecision(2) << scheduler.frame_period() << " ms\n";
+		cout << std::setw(12) << "animation" << std::setw(10) << "frames" << std::setw(10) << "fps"
+			<< std::setw(10) << "missed" << std::setw(10) << "cpu" << '\n';
+		print("unpaced", measure(fb, nullptr, [&fb](uint64_t frame) {draw_frame(fb, frame);}));
+		print("scheduled", measure(fb, &scheduler, [&fb](uint64_t frame) {draw_frame(fb, frame);}));
+		print("slow", measure(fb, &scheduler, [&fb, &scheduler](uint64_t frame) {
+			const auto start = Clock::now();
+			draw_frame(fb, frame);
+			busy_until(start, scheduler.frame_period() * 1.5 / 1000);
+		}));
+	} catch(const FramebufferError &e) {
+		std::cerr << "Cannot open the framebuffer: " << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <utils.h>
+
+#include "number.h"
+
+/*
+ * Measure how many times per second a full screen of text can be drawn on a framebuffer, as a HUD
+ * redrawn every frame would be: with draw_text() and the fonts of packed_font.h and number.h, and a pixel
+ * at a time with set(), as glyphs used to be drawn. Without a device, an offscreen framebuffer of 1920x1080
+ * is measured instead. Build it with INCLUDE_FRAMEBUFFER defined and run it like:
+ *     ./framebuffer_text_benchmark [/dev/fb0]
+ */
+
+using std::cout;
+using Clock = std::chrono::steady_clock;
+
+constexpr auto DURATION = std::chrono::milliseconds(500); // Per measurement
+constexpr Area OFFSCREEN_AREA = {1920, 1080};
+constexpr Color TEXT_COLOR = {255, 255, 255, 255};
+
+/*
+ * Lines of characters cycling through charset, enough to cover an area of screen.
+ */
+std::string screen_text(const BitmapFont &font, Area screen, uint_type scale, std::string_view charset) {
+	const Area cell = {font.glyph_size().w * scale, font.glyph_size().h * scale};
+	std::string text;
+	size_t next = 0;
+	for(uint_type y = 0; y < screen.h / cell.h; ++y) {
+		for(uint_type x = 0; x < screen.w / cell.w; ++x) text += charset[next++ % charset.size()];
+		text += '\n';
+	}
+	return text;
+}
+
+/*
+ * text drawn a pixel at a time, the glyphs read from font.
+ */
+void draw_text_by_pixels(Framebuffer &fb, const BitmapFont &font, UCoord pos, std::string_view text, uint_type scale) {
+	const Area size = font.glyph_size();
+	UCoord cursor = pos;
+	for(char c : text) {
+		if(c == '\n') {
+			cursor = {pos.x, cursor.y + size.h * scale};
+			continue;
+		}
+		if(const uint32_t *glyph = font.glyph(c)) {
+			for(uint_type y = 0; y < size.h * scale; ++y) {
+				for(uint_type x = 0; x < size.w * scale; ++x) {
+					if(glyph[y / scale] >> (x / scale) & 1) fb.set({cursor.x + x, cursor.y + y}, TEXT_COLOR);
+				}
+			}
+		}
+		cursor.x += size.w * scale;
+	}
+}
+
+/*
+ * Screens drawn per second by draw.
+ */
+template<typename Function>
+double screens_per_second(Framebuffer &fb, Function draw) {
+	size_t screens = 0;
+	const auto start = Clock::now();
+	auto now = start;
+	while(now - start < DURATION) {
+		draw();
+		fb.reset_buffer();
+		++screens;
+		now = Clock::now();
+	}
+	return screens / std::chrono::duration<double>(now - start).count();
+}
+
+int main(int argc, char **argv) {
+	BitmapFont digits({8, 16});
+	for(int digit = 0; digit < 10; ++digit) digits.set_glyph('0' + digit, &numbers[digit][0][0]);
+	const struct {
+		const char *name;
+		const BitmapFont &font;
+		uint_type scale;
+		std::string_view charset;
+	} cases[] = {
+		{"packed", BitmapFont::packed(), 1, "The quick brown fox jumps over the lazy dog. 0123456789 (+-*/) "},
+		{"packed x2", BitmapFont::packed(), 2, "The quick brown fox jumps over the lazy dog. 0123456789 (+-*/) "},
+		{"digits", digits, 1, "0123456789 "},
+		{"digits x3", digits, 3, "0123456789 "},
+	};
+
+	try {
+		Framebuffer fb = argc > 1 ? Framebuffer(argv[1]) : Framebuffer::offscreen(OFFSCREEN_AREA);
+		cout << "Full screens of text per second on " << fb.size().w << 'x' << fb.size().h << '\n';
+		cout << std::setw(12) << "font" << std::setw(12) << "characters" << std::setw(14) << "set()"
+			<< std::setw(14) << "draw_text()" << std::setw(10) << "speedup" << '\n';
+		for(const auto &c : cases) {
+			const std::string text = screen_text(c.font, fb.size(), c.scale, c.charset);
+			const double by_pixels = screens_per_second(fb, [&] {draw_text_by_pixels(fb, c.font, {0, 0}, text, c.scale);});
+			const double by_spans = screens_per_second(fb, [&] {fb.draw_text(c.font, {0, 0}, text, TEXT_COLOR, c.scale);});
+			cout << std::setw(12) << c.name << std::setw(12) << text.size() << std::fixed << std::setprecision(1)
+				<< std::setw(14) << by_pixels << std::setw(14) << by_spans << std::setw(9) << by_spans / by_pixels << "x\n";
+		}
+	} catch(const FramebufferError &e) {
+		std::cerr << "Cannot open the framebuffer: " << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <utils.h>
+
+/*
+ * Measure frames per second of full screen drawing on an offscreen framebuffer, drawn right away and
+ * in tiled mode on more and more threads, and check that the pixels are the same.
+ * Build it with INCLUDE_FRAMEBUFFER defined and run it like:
+ *     ./framebuffer_tile_benchmark [threads]
+ */
+
+using std::cout;
+using Clock = std::chrono::steady_clock;
+
+constexpr Area SCREEN_AREA = {1920, 1080};
+constexpr size_t RECTANGLES = 2000;
+constexpr auto DURATION = std::chrono::milliseconds(500); // Per measurement
+
+/*
+ * Translucent from the top left to the bottom right, so that every pixel is blended.
+ */
+Image gradient(Area size) {
+	Image image(size);
+	for(uint_type y = 0; y < size.h; ++y) {
+		for(uint_type x = 0; x < size.w; ++x) {
+			image.set({x, y}, {uint8_t(x * 255 / size.w), uint8_t(y * 255 / size.h), 128, uint8_t((x + y) * 255 / (size.w + size.h))});
+		}
+	}
+	return image;
+}
+
+struct Workload {
+	const char *name;
+	std::function<void(Framebuffer &)> draw; // One frame
+};
+
+/*
+ * Frames per second drawn by workload, rendered at the end of each.
+ */
+double frames_per_second(Framebuffer &fb, const Workload &workload) {
+	size_t frames = 0;
+	const auto start = Clock::now();
+	auto now = start;
+	while(now - start < DURATION) {
+		workload.draw(fb);
+		fb.render();
+		++frames;
+		now = Clock::now();
+	}
+	return frames / std::chrono::duration<double>(now - start).count();
+}
+
+int main(int argc, char **argv) {
+	const unsigned max_threads = argc > 1 ? std::max(1, parse_int(argv[1])) : std::max(1u, std::thread::hardware_concurrency());
+
+	const Image translucent = gradient(SCREEN_AREA);
+	Image opaque = translucent;
+	for(uint32_t &pixel : opaque.pixels) pixel |= 0xff000000;
+	std::mt19937 engine(0);
+	std::vector<std::pair<UCoord, Area>> rectangles;
+	std::vector<Color> colors;
+	for(size_t i = 0; i < RECTANGLES; ++i) {
+		rectangles.push_back({{engine() % SCREEN_AREA.w, engine() % SCREEN_AREA.h}, {1 + engine() % 200, 1 + engine() % 200}});
+		colors.push_back({uint8_t(engine()), uint8_t(engine()), uint8_t(engine()), uint8_t(engine())});
+	}
+
+	const Workload workloads[] = {
+		{"fill", [](Framebuffer &fb) {fb.fill({20, 40, 60, 255});}},
+		{"blit", [&opaque](Framebuffer &fb) {fb.blit(opaque, {0, 0}, BlendMode::REPLACE);}},
+		{"gradient", [&translucent](Framebuffer &fb) {
+			fb.fill({20, 40, 60, 255});
+			fb.blit(translucent, {0, 0});
+		}},
+		{"rectangles", [&rectangles, &colors](Framebuffer &fb) {
+			for(size_t i = 0; i < rectangles.size(); ++i) fb.fill_rectangle(rectangles[i].first, rectangles[i].second, colors[i]);
+		}},
+	};
+
+	try {
+		cout << "Frames per second on " << SCREEN_AREA.w << 'x' << SCREEN_AREA.h << ", then the speedup over drawing right away\n";
+		cout << std::setw(12) << "workload" << std::setw(10) << "direct";
+		for(unsigned threads = 1; threads <= max_threads; threads *= 2) cout << std::setw(14) << std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+		cout << std::setw(12) << "pixels" << '\n';
+
+		for(const Workload &workload : workloads) {
+			// nobuffer, so that update() and its copy don't take part
+			Framebuffer direct = Framebuffer::offscreen(SCREEN_AREA, {}, true);
+			direct.set_blend_mode(true);
+			const double direct_fps = frames_per_second(direct, workload);
+			cout << std::setw(12) << workload.name << std::fixed << std::setprecision(1) << std::setw(10) << direct_fps;
+
+			bool identical = true;
+			for(unsigned threads = 1; threads <= max_threads; threads *= 2) {
+				Framebuffer tiled = Framebuffer::offscreen(SCREEN_AREA, {}, true);
+				tiled.set_blend_mode(true);
+				tiled.set_tiled(threads);
+				const double fps = frames_per_second(tiled, workload);
+				cout << std::setw(8) << fps << " x" << std::setprecision(2) << std::setw(4) << fps / direct_fps << std::setprecision(1);
+
+				direct.fill({0, 0, 0, 255});
+				tiled.fill({0, 0, 0, 255});
+				workload.draw(direct);
+				workload.draw(tiled);
+				identical = identical && direct.snapshot().pixels == tiled.snapshot().pixels;
+			}
+			cout << std::setw(12) << (identical ? "identical" : "DIFFERENT") << '\n';
+		}
+	} catch(const FramebufferError &e) {
+		std::cerr << "Cannot make the framebuffer: " << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
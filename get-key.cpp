@@ -10,6 +10,7 @@ int main(int argc,char **argv){
 			}
 		}
 	}
+	RawMode raw_mode;
 	while(true) {
 		unsigned char c = getch();
 		printf("%d:\t%c\n", c, 32 < c && 127 > c ? c : ' ');
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <iostream>
@@ -9,22 +10,25 @@
 #include <type_traits>
 
 #include <cmath>
+#include <cstdio>
 #include <cstdint>
 #include <cassert>
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
+
+#include <unistd.h>
 
 #include <SDL2/SDL.h>
 
 #include <console.h>
 #define INCLUDE_ARGUMENT
+#define INCLUDE_FRAME_PACER
 #include <utils.h>
+#include <packed_font.h>
 
 
-using console::ArrowKeyPraser;
 using console::ColorEnum;
-using console::color_reset;
-using console::cursor_gotoxy;
 using console::screen_clear;
 
 using std::string_view;
@@ -42,9 +46,12 @@ enum class Mode {
 } mode = Mode::graphic;
 
 bool software_rendering = false;
+double target_fps = 0; // 0 for synchronizing with the display.
 
 bool enable_trick = false;
 
+std::string trace_out_path; // Empty if frames should not be dumped.
+
 
 
 
@@ -240,6 +247,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 	constexpr SDL_Color BLACK_CHESSMAN_COLOR = {40, 40, 40, 255};
 
 	constexpr SDL_Color BACKGROUND_COLOR = {230, 205, 163, 255};
+	constexpr SDL_Color BACKGROUND_LINE_COLOR = {50, 50, 50, 255}; // Color of lines, borders and star points
 	constexpr uint_type BACKGROUND_LINE_WIDTH = 3;
 	constexpr Area BACKGROUND_BLANK_BETWEEN_LINES_SIZE = {30, 30};
 	constexpr uint_type BACKGROUND_BORDER_WIDTH = 6;
@@ -322,66 +330,11 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 	class Font {
 	private:
 		/*
-		 * Raw font data, with characters from '!' to '~'
-		 * Each pixel occupies 1 bit; Each character occupies
-		 * FONT_CHARACTER_SIZE.w * FONT_CHARACTER_SIZE.h * 1 bits.
+		 * Raw font data, with characters from '!' to '~', see packed_font.h
 		 */
-		constexpr static char RAW_FONT_DATA[] =
-			"AHAABMAAHAABMAAHAABMAAHAABMAAHAAAAAAAAABMAAHAABMAAAAADJMAOHADJMA"
-			"OHAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADDAAMMAGGAPPPDPPMDDAAMMAGGAPP"
-			"PDPPMBJIAMMADDAAMMAADAAHPMDPPBPPMHDABPPADPOAHPMADDIAMODPPIPPMDPO"
-			"AAMADIAFPADGMBJLAMGMGBPDADJIAAMOAGHMDBLBIGMMBLGAHNAAOBPIAPPAHPMB"
-			"MHAHBIAMMABPGAPNIHDOBMHAHPOBPPIDMGAGAABMAAHAABMAAHAAAAAAAAAAAAAA"
-			"AAAAAAAAAAAAAAAAAAAAAAAAAOAAHIADIAAMAAHAABMAAHAABMAAHAABMAAHAAAO"
-			"AABOAADIBMAAHIAAHAAAMAADIAAOAADIAAOAADIAAOAADIABMABOAAHAAAAAAAAA"
-			"AAAAAOAADIAAOADPPIPPOAHMADLIBMHAOAMDABAAAAAAAAAAAAAAABMAAHAABMAA"
-			"HAAPPMDPPABMAAHAABMAAHAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAO"
-			"AADIABOAAHIAAAAAAAAAAAAAAAAAAAAAAAAAAPPMDPPAAAAAAAAAAAAAAAAAAAAA"
-			"AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADMAAPAADMAABOAAHIABOAAHIADOA"
-			"APIADIAAOAAPIADOAAPAADMAAPAADMAAPMADPADAPAMDMPADPMAPPADPMAPPADPM"
-			"APDMDAPAMAPMADPAADMAAPAAPMADPAADMAAPAADMAAPAADMAAPAADMAAPADPPMPP"
-			"PDPPAPPMPADPMAPAAPMADPAPPADPMDPMAPPAPMADPAAPPPPPPPDPPMPPPAAPAADM"
-			"ADMAAPAAPPADPMAADMAAPDADMMAPDPPAPPMADPAAPMAPPADPMDMPAPDMPAPDMDMP"
-			"PPPPPPAAPAADMAAPAADMPPPDPPMPAADMAAPPPDPPMAADMAAPAADMAAPPADPMAPDP"
-			"PAPPMAPMADPADMAAPAAPAADMAAPPPDPPMPADPMAPPADPMAPDPPAPPMPPPPPPPPAD"
-			"PMAPAAPAADMADMAAPAAPAADMAAPAADMAAPAADMADPMAPPAPADDMAMPMDDPAMDPMA"
-			"PPAMDPPAPPMADPAAPDPPAPPMDPPAPPMPADPMAPPADPMAPDPPMPPPAADMAAPAAPAA"
-			"DMDPMAPPAAAAAAAAAAAAHAABMAAHAAAAAAAAABMAAHAABMAAAAAAAAAAAAAAAAAA"
-			"AAAAAHAABMAAHAAAAAAAAABMAAPAADMAAPAAAAAAAAAAAAAAAAABOAAPAAHAADIA"
-			"BMAAOAABMAADIAAHAAAPAABOAAAAAAAAAAAAAAAAAABPOAHPIAAAAAAABPOAHPIA"
-			"AAAAAAAAAAAAAAAAAAAABOAADMAADIAAHAAAOAABMAAOAAHAADIADMABOAAAAAAA"
-			"AABOAAPMAHBIBIGAEBIAAOAAHAADIAAMAADAAAAAADAAAMAAAAABPAAPOAHAMDJP"
-			"JMMGHDBJMMGHBPAOAABOBIDPMAHOAAAAAPMADPADMPAPDMPADPMAPPADPMAPPPPP"
-			"PPPPADPMAPPADPMAPPPPDPPMPADPMAPPADPMAPPPPDPPMPADPMAPPADPMAPPPPDP"
-			"PMAPPADPMDMDMPAPPAADMAAPAADMAAPAADMAADMDMPAPAPPADPMPPMDPPAPAPDMD"
-			"MPADPMAPPADPMAPPADPMAPPAPDMDMPPMDPPADPPMPPPDMAAPAADMAAPAADPPAPPM"
-			"DMAAPAADMAAPAADPPMPPPPPPPPPPPAADMAAPAADMAAPPPDPPMPAADMAAPAADMAAP"
-			"AADMAAAPPMDPPDMAAPAAPAADMAAPAPPMDPPADPMAPDMDMPAPAPPMDPPPADPMAPPA"
-			"DPMAPPADPMAPPPPPPPPPADPMAPPADPMAPPADPMAPDPPMPPPADMAAPAADMAAPAADM"
-			"AAPAADMAAPAADMAAPADPPMPPPDPPMPPPADMAAPAADMAAPAADMAAPAADMAAPADDMA"
-			"MPADPAAPMAPADPMAPPAPDMDMPDMDMPAPPADPMAPPMDPPAPDPDMPMPAPPMDPDMAAP"
-			"AADMAAPAADMAAPAADMAAPAADMAAPAADMAAPAADPPMPPPPADPMAPPMPPPDPPPPPPP"
-			"PPPPPPPPPDDPMMPPADPMAPPADPMAPPADPMAPPMDPPAPPPDPPMPPPPPPPPPDPPMPP"
-			"PAPPMDPPADPMAPDPPAPPMPADPMAPPADPMAPPADPMAPPADPMAPPADPMAPDPPAPPMP"
-			"PPDPPMPADPMAPPADPMAPPADPMAPPPPDPPMPAADMAAPAADMAADPMAPPAPADPMAPPA"
-			"DPMAPPADPMAPPADPMAPDPPAPPMAADMAAPPPPDPPMPADPMAPPADPMAPPAPPMDPPPM"
-			"DPPAPDPDMPMPAPPMDPDPMAPPAPAPDMDMPAADMAADPPAPPMAADMAAPPADPMAPDPPA"
-			"PPMDPPMPPPADMAAPAADMAAPAADMAAPAADMAAPAADMAAPAADMAAPAPADPMAPPADPM"
-			"APPADPMAPPADPMAPPADPMAPPADPMAPDPPAPPMPADPMAPPADPMAPPADPMAPPMPPPD"
-			"PDPPAPPMAPMADPAADAAAMAPADPMAPPADPMAPPDDPMMPPPPPPPPPPPPPPPPMPPPDP"
-			"PADPMAPPADPMAPDMPAPDMAPMADPAAPMADPADMPAPDMPADPMAPMAAPAADDMDMPAPD"
-			"MDMPAPDMDMPAPAPPADPMADMAAPAADMAAPAADMAAPADPPMPPPAADMAAPAAPAADMAD"
-			"MAAPAAPAADMADMAAPAADPPMPPPAAAAAHMABPAAGAABIAAGAABIAAGAABIAAGAABI"
-			"AAHMABPAAAAAPAADMAAPAADMAAPIADOAADIAAOAADOAAPIABOAAHIABOAAHIAAAA"
-			"PIADOAABIAAGAABIAAGAABIAAGAABIAAGAAPIADOAAAAAAAAAAMAAHIADDABIGAM"
-			"AMGABIAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
-			"AAAAAPPMDPPAAAAAAAABIAAHAABOAADIAAGAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
-			"AAAAABOAAPIADIAAOAADIABOAAHIAAOAADIAAOAADOAAHIAAAADAAAMAADAAAMAA"
-			"DAAAMAADAAAMAADAAAMAADAAAMAADAAAMAAAABOAAHMAAHAABMAAHAABOAAHIABM"
-			"AAHAABMABPAAHIAAAAAAAAADIEBPDAMPICBMAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
-			"AAAA";
-
-		constexpr static Area FONT_CHARACTER_SIZE = {14, 14};
+		constexpr static const char *RAW_FONT_DATA = PACKED_FONT_DATA;
+
+		constexpr static Area FONT_CHARACTER_SIZE = PACKED_FONT_CHARACTER_SIZE;
 		constexpr static size_t SCALE_TIME = 2;
 	public:
 		constexpr static size_t CHARACTER_COUNT = '~' - '!' - 26 + 1;
@@ -436,7 +389,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		static uint_type get_character_position(char c) {
 			assert(c >= '!' && c <= '~' && (c < 'a' || c > 'z'));
 
-			return c < 'a'? c - '!' : c - 26 - '!';
+			return packed_font_index(c);
 		}
 
 
@@ -598,6 +551,12 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 
 		void draw(SDL_Renderer *render, bool mouse_hovering) {draw_function(render, mouse_hovering);}
 
+		/*
+		 * Whether the widget takes the keyboard focus when clicked.
+		 * Only the focused widget receives keyboard events.
+		 */
+		bool focusable() const {return focusable_function();}
+
 	protected:
 		URect region;
 
@@ -609,11 +568,18 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		virtual void on_key_typed_function(SDL_Scancode, SDL_Keycode) = 0;
 		virtual void on_key_released_function(SDL_Scancode, SDL_Keycode) = 0;
 		virtual void draw_function(SDL_Renderer *, bool) = 0;
+		virtual bool focusable_function() const = 0;
 	};
 
 	class WidgetManager {
 	public:
-		WidgetManager(SDL_Renderer *render_) : render(render_) {}
+		/*
+		 * Maximum amount of events polled in one call of handle_events.
+		 * The remaining events stay in the queue until the next frame.
+		 */
+		constexpr static size_t MAX_EVENTS_PER_FRAME = 256;
+
+		WidgetManager(SDL_Renderer *render_) : render(render_), focused_widget(nullptr) {}
 
 		/*
 		 * Register a widget.
@@ -627,9 +593,11 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 
 		struct EventResult {
 			bool should_exit;
+			bool toggle_frame_stats; // F3 was pressed.
 		};
 		/*
-		 * This function will call SDL_PollEvent.
+		 * This function will call SDL_PollEvent, at most MAX_EVENTS_PER_FRAME times.
+		 * Consecutive mouse motion events are coalesced, only the latest position is dispatched.
 		 * Return some information about the event handled but not processed.
 		 */
 		EventResult handle_events();
@@ -641,6 +609,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 
 		/*
 		 * Should be called when a mouse click event arises.
+		 * The widget clicked gets the keyboard focus if it is focusable, otherwise nothing is focused.
 		 * Return whether a widget captures the event.
 		 */
 		bool mouse_button_down(UCoord mouse_coord);
@@ -648,12 +617,13 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		void mouse_move(UCoord mouse_coord, bool mouse_position_changed);
 
 		/*
-		 * Note that this function will send the keyboard event to all widgets.
+		 * Note that this function will only send the keyboard event to the focused widget.
 		 */
 		void keyboard_event(SDL_KeyboardEvent event);
 
 		std::vector<WidgetNode> widgets;
 		SDL_Renderer *render;
+		Widget *focused_widget;
 	};
 
 	void WidgetManager::draw() {
@@ -665,21 +635,29 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		SDL_RenderSetViewport(render, nullptr);
 	}
 	auto WidgetManager::handle_events() -> EventResult {
-		EventResult event_result = {false};
-		bool is_mouse_pressed = false; // Handle events.
-		bool is_mouse_moved = false;
+		EventResult event_result = {false, false};
+		bool is_mouse_moved = false; // Whether there is a mouse motion not dispatched yet.
+		UCoord mouse_coord;
 		SDL_Event event;
-		while(SDL_PollEvent(&event)) {
+		for(size_t polled = 0; polled < MAX_EVENTS_PER_FRAME && SDL_PollEvent(&event); ++polled) {
 			switch(event.type) {
 				case SDL_MOUSEMOTION:
 					is_mouse_moved = true;
+					mouse_coord = {static_cast<uint_type>(event.motion.x), static_cast<uint_type>(event.motion.y)};
 					break;
 				case SDL_MOUSEBUTTONDOWN:
 					if(event.button.button == SDL_BUTTON_LEFT) {
-						is_mouse_pressed = true;
+						if(is_mouse_moved) { // Widgets should see where the mouse was before the click.
+							mouse_move(mouse_coord, true);
+							is_mouse_moved = false;
+						}
+						mouse_button_down({static_cast<uint_type>(event.button.x), static_cast<uint_type>(event.button.y)});
 					}
 					break;
 				case SDL_KEYDOWN: case SDL_KEYUP:
+					if(event.key.state == SDL_PRESSED && event.key.repeat == 0 && event.key.keysym.sym == SDLK_F3) {
+						event_result.toggle_frame_stats = true;
+					}
 					keyboard_event(event.key);
 					break;
 
@@ -689,27 +667,23 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 			}
 		}
 
-		UCoord mouse_coord; // Get mouse state.
-		{
-			int x, y;
-			SDL_GetMouseState(&x, &y);
-			mouse_coord.x = x;
-			mouse_coord.y = y;
-		}
 		if(is_mouse_moved) {
 			mouse_move(mouse_coord, true);
-		} else {
-			mouse_move(mouse_coord, false);
+		} else { // Widgets may have been moved, so hovering is still updated.
+			int x, y;
+			SDL_GetMouseState(&x, &y);
+			mouse_move({static_cast<uint_type>(x), static_cast<uint_type>(y)}, false);
 		}
-		if(is_mouse_pressed) mouse_button_down(mouse_coord);
 		return event_result;
 	}
 	bool WidgetManager::mouse_button_down(UCoord c) {
 		bool captured = false; // used to record whether the click event is already captured by a widget.
+		focused_widget = nullptr;
 		for(WidgetNode &widget_node: widgets) {
 			if(ucoord_in_rect(c, widget_node.widget.region) && !captured) {
 				UCoord coord = widget_node.widget.region.coord;
 				widget_node.widget.on_click({c.x - coord.x, c.y - coord.y});
+				if(widget_node.widget.focusable()) focused_widget = &widget_node.widget;
 				captured = true;
 			} else {
 				widget_node.widget.on_click_outside();
@@ -732,15 +706,14 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		}
 	}
 	void WidgetManager::keyboard_event(SDL_KeyboardEvent event) {
-		for(WidgetNode &widget_node : widgets) {
-			if(event.state == SDL_RELEASED) {
-				widget_node.widget.on_key_released(event.keysym.scancode, event.keysym.sym);
-			} else if(event.state == SDL_PRESSED) {
-				if(event.repeat == 0) {
-					widget_node.widget.on_key_pressed(event.keysym.scancode, event.keysym.sym);
-				} else {
-					widget_node.widget.on_key_typed(event.keysym.scancode, event.keysym.sym);
-				}
+		if(!focused_widget) return;
+		if(event.state == SDL_RELEASED) {
+			focused_widget->on_key_released(event.keysym.scancode, event.keysym.sym);
+		} else if(event.state == SDL_PRESSED) {
+			if(event.repeat == 0) {
+				focused_widget->on_key_pressed(event.keysym.scancode, event.keysym.sym);
+			} else {
+				focused_widget->on_key_typed(event.keysym.scancode, event.keysym.sym);
 			}
 		}
 	}
@@ -775,6 +748,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		virtual void on_key_typed_function(SDL_Scancode, SDL_Keycode) override {}
 		virtual void on_key_released_function(SDL_Scancode, SDL_Keycode) override {}
 		virtual void draw_function(SDL_Renderer *render, bool mouse_hovering) override;
+		virtual bool focusable_function() const override {return false;}
 
 		std::string title;
 		std::function<on_click_callback_t> on_click_callback;
@@ -831,6 +805,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		virtual void on_key_typed_function(SDL_Scancode, SDL_Keycode k) {m_key_pressed(k);}
 		virtual void on_key_released_function(SDL_Scancode, SDL_Keycode) {}
 		virtual void draw_function(SDL_Renderer *, bool);
+		virtual bool focusable_function() const {return true;}
 
 		void m_key_pressed(SDL_Keycode key);
 
@@ -1042,6 +1017,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		virtual void on_key_typed_function(SDL_Scancode, SDL_Keycode) {}
 		virtual void on_key_released_function(SDL_Scancode, SDL_Keycode) {}
 		virtual void draw_function(SDL_Renderer *, bool);
+		virtual bool focusable_function() const {return false;}
 
 		std::string m_content;
 		
@@ -1054,6 +1030,12 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 	class Chessboard : public Widget {
 		constexpr static Area CHESSMAN_AREA = { (BACKGROUND_BLANK_BETWEEN_LINES_SIZE.w + BACKGROUND_LINE_WIDTH) * 3 / 4,
 				(BACKGROUND_BLANK_BETWEEN_LINES_SIZE.h + BACKGROUND_LINE_WIDTH) * 3 / 4 };
+		constexpr static Area BACKGROUND_CELL_AREA = { BACKGROUND_BLANK_BETWEEN_LINES_SIZE.w + BACKGROUND_LINE_WIDTH,
+				BACKGROUND_BLANK_BETWEEN_LINES_SIZE.h + BACKGROUND_LINE_WIDTH };
+		constexpr static Area BACKGROUND_TILE_CELLS = {8, 8};
+		constexpr static Area BACKGROUND_TILE_AREA = { BACKGROUND_CELL_AREA.w * BACKGROUND_TILE_CELLS.w,
+				BACKGROUND_CELL_AREA.h * BACKGROUND_TILE_CELLS.h };
+		constexpr static int STAR_POINT_RADIUS = BACKGROUND_BLANK_BETWEEN_LINES_SIZE.w / 10;
 	public:
 		Chessboard(SDL_Renderer *render, SDL_PixelFormat *format, UCoord position);
 		~Chessboard();
@@ -1072,10 +1054,16 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		 */
 		static URect chessman_rect_on_screen(UCoord coord);
 		/*
-		 * Generate the background surface.
+		 * Generate a tile of the background, which covers BACKGROUND_TILE_CELLS grid squares,
+		 * each with its line at the right and at the bottom. The grid of the map is made of
+		 * repeated copies of it, so its size doesn't grow with the map.
 		 * Return the surface handle, which requires to be freed by SDL_FreeSurface manually.
 		 */
-		static SDL_Surface *generate_background_surface(SDL_PixelFormat *format);
+		static SDL_Surface *generate_background_tile_surface(SDL_PixelFormat *format);
+		/*
+		 * Draw the grid by copying the background tile, then borders and star points over it.
+		 */
+		void draw_background(SDL_Renderer *render);
 
 		virtual void on_mouse_move_on_function(UCoord mouse_coord, bool mouse_position_changed) override;
 		virtual void on_mouse_move_out_function() override;
@@ -1085,6 +1073,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		virtual void on_key_typed_function(SDL_Scancode, SDL_Keycode) override {}
 		virtual void on_key_released_function(SDL_Scancode, SDL_Keycode) override {}
 		virtual void draw_function(SDL_Renderer *render, bool mouse_hovering) override;
+		virtual bool focusable_function() const override {return false;}
 
 		void m_select_chessman(UCoord mouse_coord);
 
@@ -1092,7 +1081,8 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		UCoord coord_of_chessman_selecting;
 		CoreGame game;
 
-		SDL_Texture *background_texture;
+		SDL_Texture *background_tile_texture;
+		SDL_Texture *star_point_texture;
 
 		SDL_Texture *black_chessman_texture, *black_chessman_transparent_texture;
 		SDL_Texture *white_chessman_texture, *white_chessman_transparent_texture;
@@ -1103,9 +1093,17 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 	{
 		reset();
 
-		SDL_Surface *background_surface = generate_background_surface(format);
-		background_texture = SDL_CreateTextureFromSurface(render, background_surface);
-		SDL_FreeSurface(background_surface);
+		SDL_Surface *background_tile_surface = generate_background_tile_surface(format);
+		background_tile_texture = SDL_CreateTextureFromSurface(render, background_tile_surface);
+		SDL_FreeSurface(background_tile_surface);
+
+		SDL_Surface *star_point_surface = SDL_CreateRGBSurface(0, STAR_POINT_RADIUS * 2 + 1, STAR_POINT_RADIUS * 2 + 1, 32,
+				0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF);
+		SDL_FillRect(star_point_surface, nullptr, SDL_MapRGBA(star_point_surface->format, 255, 255, 255, 0));
+		filledCircleRGBA(star_point_surface, STAR_POINT_RADIUS, STAR_POINT_RADIUS, STAR_POINT_RADIUS,
+				SDL_MapRGBA(star_point_surface->format, BACKGROUND_LINE_COLOR.r, BACKGROUND_LINE_COLOR.g, BACKGROUND_LINE_COLOR.b, 255));
+		star_point_texture = SDL_CreateTextureFromSurface(render, star_point_surface);
+		SDL_FreeSurface(star_point_surface);
 
 		SDL_Surface *sur = SDL_CreateRGBSurface(0, CHESSMAN_AREA.w, CHESSMAN_AREA.h, 32,
 				0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF);
@@ -1142,7 +1140,8 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		SDL_FreeSurface(sur);
 	}
 	Chessboard::~Chessboard() {
-		SDL_DestroyTexture(background_texture);
+		SDL_DestroyTexture(background_tile_texture);
+		SDL_DestroyTexture(star_point_texture);
 		SDL_DestroyTexture(black_chessman_texture);
 		SDL_DestroyTexture(black_chessman_transparent_texture);
 		SDL_DestroyTexture(white_chessman_texture);
@@ -1184,7 +1183,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		is_selecting_chessman = false;
 	}
 	void Chessboard::draw_function(SDL_Renderer *render, bool /* mouse_hovering */) {
-		SDL_RenderCopy(render, background_texture, nullptr, nullptr);
+		draw_background(render);
 
 		for(uint_type y = 0; y < map_size.h; ++y) {
 			for(uint_type x = 0; x < map_size.w; ++x) {
@@ -1236,28 +1235,49 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 			CHESSMAN_AREA
 		};
 	}
-	SDL_Surface *Chessboard::generate_background_surface(SDL_PixelFormat *format) {
+	SDL_Surface *Chessboard::generate_background_tile_surface(SDL_PixelFormat *format) {
 		const auto background_color = SDL_MapRGB(format, BACKGROUND_COLOR.r,
 				BACKGROUND_COLOR.g, BACKGROUND_COLOR.b);
-		const auto black_color = SDL_MapRGB(format, 50, 50, 50);
-
+		const auto line_color = SDL_MapRGB(format, BACKGROUND_LINE_COLOR.r,
+				BACKGROUND_LINE_COLOR.g, BACKGROUND_LINE_COLOR.b);
 
-		SDL_Surface *background_surface = SDL_CreateRGBSurfaceWithFormat(0, real_map_size.w, real_map_size.h, 0, format->format);
-		SDL_FillRect(background_surface, nullptr, black_color);
-		for(uint_type x = 0; x < map_size.w + 1; ++x) {
-			for(uint_type y = 0; y < map_size.h + 1; ++y) {
+		SDL_Surface *tile_surface = SDL_CreateRGBSurfaceWithFormat(0, BACKGROUND_TILE_AREA.w, BACKGROUND_TILE_AREA.h, 0, format->format);
+		SDL_FillRect(tile_surface, nullptr, line_color);
+		for(uint_type x = 0; x < BACKGROUND_TILE_CELLS.w; ++x) {
+			for(uint_type y = 0; y < BACKGROUND_TILE_CELLS.h; ++y) {
 				SDL_Rect r = URect{
-					{
-						BACKGROUND_BORDER_WIDTH + x *
-							(BACKGROUND_BLANK_BETWEEN_LINES_SIZE.w + BACKGROUND_LINE_WIDTH),
-						BACKGROUND_BORDER_WIDTH + y *
-							(BACKGROUND_BLANK_BETWEEN_LINES_SIZE.h + BACKGROUND_LINE_WIDTH)
-					},
+					{x * BACKGROUND_CELL_AREA.w, y * BACKGROUND_CELL_AREA.h},
 					BACKGROUND_BLANK_BETWEEN_LINES_SIZE
 				};
-				SDL_FillRect(background_surface, &r, background_color);
+				SDL_FillRect(tile_surface, &r, background_color);
 			}
 		}
+		return tile_surface;
+	}
+	void Chessboard::draw_background(SDL_Renderer *render) {
+		// The grid has one more square than lines in each direction. Its last line lies within the border.
+		const Area grid_area = {(map_size.w + 1) * BACKGROUND_CELL_AREA.w, (map_size.h + 1) * BACKGROUND_CELL_AREA.h};
+		for(uint_type y = 0; y < grid_area.h; y += BACKGROUND_TILE_AREA.h) {
+			for(uint_type x = 0; x < grid_area.w; x += BACKGROUND_TILE_AREA.w) {
+				const Area a = {
+					std::min(BACKGROUND_TILE_AREA.w, grid_area.w - x),
+					std::min(BACKGROUND_TILE_AREA.h, grid_area.h - y)
+				};
+				SDL_Rect srcrect = URect{{0, 0}, a};
+				SDL_Rect dstrect = URect{{BACKGROUND_BORDER_WIDTH + x, BACKGROUND_BORDER_WIDTH + y}, a};
+				SDL_RenderCopy(render, background_tile_texture, &srcrect, &dstrect);
+			}
+		}
+
+		const SDL_Rect borders[4] = {
+			URect{{0, 0}, {real_map_size.w, BACKGROUND_BORDER_WIDTH}},
+			URect{{0, real_map_size.h - BACKGROUND_BORDER_WIDTH}, {real_map_size.w, BACKGROUND_BORDER_WIDTH}},
+			URect{{0, 0}, {BACKGROUND_BORDER_WIDTH, real_map_size.h}},
+			URect{{real_map_size.w - BACKGROUND_BORDER_WIDTH, 0}, {BACKGROUND_BORDER_WIDTH, real_map_size.h}}
+		};
+		SDL_SetRenderDrawColor(render, BACKGROUND_LINE_COLOR.r, BACKGROUND_LINE_COLOR.g, BACKGROUND_LINE_COLOR.b, BACKGROUND_LINE_COLOR.a);
+		SDL_RenderFillRects(render, borders, 4);
+
 		if(map_size.w > 2 && map_size.h > 2) {
 			UCoord coords[4] = {
 				chessman_coord_on_screen({2, 2}),
@@ -1266,10 +1286,125 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 				chessman_coord_on_screen({map_size.w - 3, map_size.h - 3}),
 			};
 			for(UCoord coord : coords) {
-				filledCircleRGBA(background_surface, coord.x, coord.y, BACKGROUND_BLANK_BETWEEN_LINES_SIZE.w / 10, black_color);
+				SDL_Rect r{static_cast<int>(coord.x) - STAR_POINT_RADIUS, static_cast<int>(coord.y) - STAR_POINT_RADIUS,
+					STAR_POINT_RADIUS * 2 + 1, STAR_POINT_RADIUS * 2 + 1};
+				SDL_RenderCopy(render, star_point_texture, nullptr, &r);
+			}
+		}
+	}
+
+	/*
+	 * Records how long each phase of a frame takes, for the last FRAME_HISTORY frames.
+	 * Time is measured with SDL's high-resolution performance counter.
+	 */
+	class FrameProfiler {
+	public:
+		enum class Phase : uint8_t {
+			EVENTS = 0, LOGIC, DRAW, PRESENT
+		};
+		constexpr static size_t PHASE_COUNT = 4;
+		constexpr static size_t FRAME_HISTORY = 1024;
+
+		FrameProfiler() : frames(FRAME_HISTORY), next(0), count(0), frequency(SDL_GetPerformanceFrequency()), current{} {}
+
+		/*
+		 * Start timing a new frame. The first phase starts at the same time.
+		 */
+		void begin_frame() {current.start = SDL_GetPerformanceCounter();}
+		/*
+		 * Mark the end of a phase; the following phase starts right after it.
+		 * Phases are expected to be ended in the order they are declared.
+		 */
+		void end_phase(Phase phase) {current.phase_end[static_cast<size_t>(phase)] = SDL_GetPerformanceCounter();}
+		/*
+		 * Commit the current frame into the history, overwriting the oldest one if the history is full.
+		 */
+		void end_frame();
+
+		/*
+		 * Frames per second, averaged over the frames recorded during the last second.
+		 */
+		double fps() const;
+		/*
+		 * Duration of a phase in milliseconds at the given percentile(0 to 100) of the recorded frames.
+		 */
+		double percentile(Phase phase, double p) const;
+
+		/*
+		 * Dump the recorded frames in Chrome trace event format, viewable in chrome://tracing or Perfetto.
+		 * Return whether the file is written successfully.
+		 */
+		bool write_chrome_trace(const char *path) const;
+	private:
+		struct Frame {
+			Uint64 start;
+			Uint64 phase_end[PHASE_COUNT];
+		};
+		constexpr static const char *PHASE_NAMES[PHASE_COUNT] = {"events", "logic", "draw", "present"};
+
+		/*
+		 * Access the recorded frames, with 0 being the oldest one.
+		 */
+		const Frame &frame(size_t index) const {
+			assert(index < count);
+			return frames[(next + FRAME_HISTORY - count + index) % FRAME_HISTORY];
+		}
+		Uint64 phase_start(const Frame &f, size_t phase) const {
+			return phase == 0 ? f.start : f.phase_end[phase - 1];
+		}
+		double to_ms(Uint64 ticks) const {return ticks * 1000.0 / frequency;}
+
+		std::vector<Frame> frames; // Ring buffer.
+		size_t next, count;
+		Uint64 frequency;
+		Frame current;
+	};
+	void FrameProfiler::end_frame() {
+		frames[next] = current;
+		next = (next + 1) % FRAME_HISTORY;
+		if(count < FRAME_HISTORY) ++count;
+	}
+	double FrameProfiler::fps() const {
+		if(count < 2) return 0;
+		const Uint64 newest = frame(count - 1).start;
+		size_t index = count - 1;
+		while(index > 0 && newest - frame(index - 1).start <= frequency) --index;
+		if(index == count - 1) return 0;
+		return (count - 1 - index) * static_cast<double>(frequency) / (newest - frame(index).start);
+	}
+	double FrameProfiler::percentile(Phase phase, double p) const {
+		if(count == 0) return 0;
+		const size_t phase_index = static_cast<size_t>(phase);
+		std::vector<Uint64> durations(count);
+		for(size_t i = 0; i < count; ++i) {
+			durations[i] = frame(i).phase_end[phase_index] - phase_start(frame(i), phase_index);
+		}
+		const size_t nth = static_cast<size_t>(p / 100 * (count - 1) + 0.5);
+		std::nth_element(durations.begin(), durations.begin() + nth, durations.end());
+		return to_ms(durations[nth]);
+	}
+	bool FrameProfiler::write_chrome_trace(const char *path) const {
+		FILE *file = fopen(path, "w");
+		if(!file) return false;
+		fprintf(file, "{\"traceEvents\":[\n");
+		const Uint64 origin = count == 0 ? 0 : frame(0).start;
+		auto to_us = [this](Uint64 ticks) {return ticks * 1000000.0 / frequency;};
+		bool first = true;
+		auto write_event = [&](const char *name, Uint64 start, Uint64 end) {
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+					first ? "" : ",\n", name, to_us(start - origin), to_us(end - start));
+			first = false;
+		};
+		for(size_t i = 0; i < count; ++i) {
+			const Frame &f = frame(i);
+			write_event("frame", f.start, f.phase_end[PHASE_COUNT - 1]);
+			for(size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+				write_event(PHASE_NAMES[phase], phase_start(f, phase), f.phase_end[phase]);
 			}
 		}
-		return background_surface;
+		fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+		bool success = !ferror(file);
+		return fclose(file) == 0 && success;
 	}
 
 	/*
@@ -1288,11 +1423,23 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 
 		void start();
 	private:
+		constexpr static Uint64 FRAME_STATS_REFRESH_DELAY = 250;
+
 		void mainmenu_logic();
 		void offline_gaming_logic();
+		/*
+		 * Get the widgets of current status.
+		 */
+		WidgetManager &current_widgets();
+		/*
+		 * Draw FPS and the p50/p99 duration of each phase at the topleft of the window.
+		 */
+		void draw_frame_stats();
 
 		SDL_Window *window;
 		SDL_Renderer *render;
+		SDL_PixelFormat *format;
+		FramePacer pacer;
 		unique_ptr<Font> font;
 		Status status;
 
@@ -1308,10 +1455,15 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 
 		bool request_stop;
 
+		FrameProfiler profiler;
+		bool show_frame_stats;
+		std::string frame_stats_text;
+		Uint64 frame_stats_tick; // Used to refresh frame_stats_text periodically.
+
 		Uint64 trick_helper; //ONLY FOR TRICK
 	};
 
-	Game::Game() : status(Status::MAINMENU), request_stop(false) {
+	Game::Game() : pacer(target_fps > 0 ? FramePacer::Mode::TARGET_FPS : FramePacer::Mode::VSYNC, target_fps), status(Status::MAINMENU), request_stop(false), show_frame_stats(false), frame_stats_tick(0) {
 		// Initialize SDL2
 		if(SDL_Init(SDL_INIT_EVENTS | SDL_INIT_VIDEO) < 0) {
 			log_error("Error initializing SDL2: %s.", SDL_GetError());
@@ -1327,43 +1479,21 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 			log_error("Error occurred creating the main window: %s.", SDL_GetError());
 			exit(1);
 		}
+		SDL_ShowWindow(window);
 		// Preparing renderer
-		SDL_Surface *screen;
-		auto software_rendering_setup_f = [&screen, this] (){
-			screen = SDL_GetWindowSurface(window);
-			render = SDL_CreateSoftwareRenderer(screen);
-			if(!render) {
-				log_error("Can't create software renderer.");
-				exit(1);
-			}
-		};
-		if(software_rendering) {
-			software_rendering_setup_f();
-		} else {
-			render = SDL_CreateRenderer(window, -1,
-					SDL_RENDERER_ACCELERATED/* | SDL_RENDERER_PRESENTVSYNC */);
-			if(render) {
-				screen = SDL_GetWindowSurface(window);
-				if (!screen) {
-					log_error("Error: %s. Falling back to software rendering.");
-					SDL_DestroyRenderer(render);
-					render = nullptr;
-					software_rendering_setup_f();
-					software_rendering = true;
-				}
-			} else {
-				log_error("Warning: cannot create renderer with hardware acceleration: %s.", SDL_GetError());
-				render = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
-				screen = SDL_GetWindowSurface(window);
-				if(!render) {
-					log_error("Can't create renderer.");
-					exit(1);
-				}
-			}
+		render = pacer.create_renderer(window, !software_rendering);
+		if(!render) {
+			log_error("Can't create renderer.");
+			exit(1);
+		}
+		format = SDL_AllocFormat(SDL_GetWindowPixelFormat(window));
+		if(!format) {
+			log_error("Error getting the pixel format of the main window: %s.", SDL_GetError());
+			exit(1);
 		}
 		SDL_SetRenderDrawBlendMode(render, SDL_BLENDMODE_BLEND);
 
-		font.reset(new Font(screen->format, render, {0x20, 0x20, 0x20, 0xFF}));
+		font.reset(new Font(format, render, {0x20, 0x20, 0x20, 0xFF}));
 
 
 		// Setting up widgets
@@ -1424,7 +1554,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 		chessboard_textfield->set_coord({0, background_blank_outof_map_size.h / 3});
 		offline_gaming_widgets->register_widget(*chessboard_textfield);
 
-		chessboard.reset(new Chessboard(render, screen->format, static_cast<UCoord>(background_blank_outof_map_size)));
+		chessboard.reset(new Chessboard(render, format, static_cast<UCoord>(background_blank_outof_map_size)));
 		offline_gaming_widgets->register_widget(*chessboard);
 	}
 
@@ -1443,6 +1573,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 
 		font.reset();
 
+		SDL_FreeFormat(format);
 		SDL_DestroyRenderer(render);
 		SDL_DestroyWindow(window);
 		SDL_Quit();
@@ -1455,10 +1586,6 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 				trick_helper = SDL_GetTicks64();
 			}
 		}
-		if(mainmenu_widgets->handle_events().should_exit) {
-			request_stop = true;
-		}
-		mainmenu_widgets->draw();
 	}
 
 	void Game::offline_gaming_logic() {
@@ -1477,19 +1604,50 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 			chessboard_textfield->set_content(game.status() == CoreGame::Status::WHITE_WON ? "White won!" : "Black won!");
 		}
 		chessboard_textfield->set_central_coord_x(window_size.w / 2);
+	}
 
-		if(offline_gaming_widgets->handle_events().should_exit) {
-			request_stop = true;
+	WidgetManager &Game::current_widgets() {
+		switch(status) {
+			case Status::MAINMENU:
+				return *mainmenu_widgets;
+			case Status::OFFLINE_GAMING:
+				return *offline_gaming_widgets;
 		}
-		offline_gaming_widgets->draw();
+		return *mainmenu_widgets; //avoid warning
+	}
+
+	void Game::draw_frame_stats() {
+		using Phase = FrameProfiler::Phase;
+		if(SDL_GetTicks64() - frame_stats_tick >= FRAME_STATS_REFRESH_DELAY) {
+			constexpr std::pair<Phase, const char *> phases[] = {
+				{Phase::EVENTS, "EVT"}, {Phase::LOGIC, "LGC"}, {Phase::DRAW, "DRW"}, {Phase::PRESENT, "PRS"}
+			};
+			char line[64];
+			snprintf(line, sizeof(line), "FPS %.1f", profiler.fps());
+			frame_stats_text = line;
+			for(auto [phase, name] : phases) { // Milliseconds, p50 and p99
+				snprintf(line, sizeof(line), "\n%s %.2f %.2f", name, profiler.percentile(phase, 50), profiler.percentile(phase, 99));
+				frame_stats_text += line;
+			}
+			frame_stats_tick = SDL_GetTicks64();
+		}
+		SDL_Rect rect = URect{{0, 0}, Font::text_size(frame_stats_text)};
+		SDL_SetRenderDrawColor(render, 255, 255, 255, 160);
+		SDL_RenderFillRect(render, &rect);
+		font->render_text(render, frame_stats_text, {0, 0});
 	}
 
 	void Game::start() {
-		SDL_ShowWindow(window);
+		using Phase = FrameProfiler::Phase;
 		trick_helper = 0;
 		while(!request_stop) {
-			SDL_SetRenderDrawColor(render, BACKGROUND_COLOR.r, BACKGROUND_COLOR.g, BACKGROUND_COLOR.b, 255);
-			SDL_RenderClear(render);
+			profiler.begin_frame();
+
+			WidgetManager::EventResult event_result = current_widgets().handle_events();
+			if(event_result.should_exit) request_stop = true;
+			if(event_result.toggle_frame_stats) show_frame_stats = !show_frame_stats;
+			if(request_stop) break; // For SDL_QUIT may be handled or the exit button may be clicked.
+			profiler.end_phase(Phase::EVENTS);
 
 			switch(status) {
 				case Status::MAINMENU:
@@ -1499,13 +1657,22 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
 					offline_gaming_logic();
 					break;
 			}
-			if(request_stop) break; // For SDL_QUIT may be handled in logic function.
+			profiler.end_phase(Phase::LOGIC);
 
-			if(software_rendering) {
-				SDL_UpdateWindowSurface(window);
-			} else {
-				SDL_RenderPresent(render);
-			}
+			SDL_SetRenderDrawColor(render, BACKGROUND_COLOR.r, BACKGROUND_COLOR.g, BACKGROUND_COLOR.b, 255);
+			SDL_RenderClear(render);
+			current_widgets().draw();
+			if(show_frame_stats) draw_frame_stats();
+			profiler.end_phase(Phase::DRAW);
+
+			pacer.present();
+			profiler.end_phase(Phase::PRESENT);
+			profiler.end_frame();
+
+			pacer.wait();
+		}
+		if(!trace_out_path.empty() && !profiler.write_chrome_trace(trace_out_path.c_str())) {
+			log_error("Can't write trace to \"%s\": %s.", trace_out_path.c_str(), strerror(errno));
 		}
 	}
 }
@@ -1516,7 +1683,7 @@ namespace frontend_with_SDL2 { // ---------------- Frontend with SDL2
  * Gobang in terminal.
  */
 namespace frontend_with_console {
-	constexpr ColorEnum EMPTY_COLOR = ColorEnum::PURPLE;
+	constexpr Color EMPTY_COLOR = {200, 150, 80, 255}; // Wood, shown as yellow where only 8 colors are supported
 	constexpr ColorEnum WHITE_COLOR = ColorEnum::WHITE;
 	constexpr ColorEnum BLACK_COLOR = ColorEnum::BLACK;
 	constexpr ColorEnum SELECTION_COLOR = ColorEnum::CYAN;
@@ -1530,107 +1697,56 @@ namespace frontend_with_console {
 			case console::Key::DOWN: return Key::DOWN;
 			case console::Key::LEFT: return Key::LEFT;
 			case console::Key::RIGHT: return Key::RIGHT;
+			default: break;
 		}
 		return Key::UP; //avoid warning
 	}
 
-	/*
-	 * Print the content of a CoreGame.
-	 * Ensure the position of cursor is topleft before calling.
-	 * The position of cursor is set to {0, MAP_SIZE.h + 2} after the function finishes.
-	 */
-	void print(const CoreGame &g) {
-		putchar('|');
-		for(uint_type i = 0; i < map_size.w * 2; ++i) putchar('-');
-		putchar('|');
-		putchar('\n');
-		for(uint_type y = 0; y < map_size.h; ++y) {
-			putchar('|');
-			for(uint_type x = 0; x < map_size.w; ++x) {
-				ColorEnum color;
-				switch(g[{x, y}]) {
-					case CoreGame::Unit::EMPTY:
-						color = EMPTY_COLOR;
-						break;
-					case CoreGame::Unit::WHITE:
-						color = WHITE_COLOR;
-						break;
-					case CoreGame::Unit::BLACK:
-						color = BLACK_COLOR;
-						break;
-					default:
-						color = EMPTY_COLOR; //AVOID STUPID WARNING FROM GCC
-				}
-				if(x == 0 || g[{x - 1, y}] != g[{x, y}]) background_color(color);
-				printf("  ");
-				if(x == map_size.w - 1 || g[{x, y}] != g[{x + 1, y}]) color_reset();
-			}
-			putchar('|');
-			putchar('\n');
+	constexpr console::CellColor unit_color(CoreGame::Unit unit) {
+		switch(unit) {
+			case CoreGame::Unit::EMPTY: return EMPTY_COLOR;
+			case CoreGame::Unit::WHITE: return WHITE_COLOR;
+			case CoreGame::Unit::BLACK: return BLACK_COLOR;
 		}
-		putchar('|');
-		for(uint_type i = 0; i < map_size.w * 2; ++i) putchar('-');
-		putchar('|');
-		putchar('\n');
+		return EMPTY_COLOR; //AVOID STUPID WARNING FROM GCC
 	}
+
+	constexpr uint_type MINIMAL_SCREEN_WIDTH = 16; // Leave room for the status line
+
 	/*
-	 * Print the difference between the output of ``print(game)`` and ``print(bufgame)``.
-	 * Ensure the position of cursor is topleft before calling.
-	 * The position of cursor is set to {0, MAP_SIZE.h + 2} after a call completes.
+	 * Draw the content of a CoreGame, the selection and the status line on the back buffer of screen.
 	 */
-	void print_diff(const CoreGame &game, const CoreGame &bufgame) {
-		for(uint_type x = 0; x < map_size.w; ++x) {
-			for(uint_type y = 0; y < map_size.h; ++y) {
-				if(game[{x, y}] != bufgame[{x, y}]) {
-					ColorEnum color;
-					switch(game[{x, y}]) {
-						case CoreGame::Unit::EMPTY:
-							color = EMPTY_COLOR;
-							break;
-						case CoreGame::Unit::WHITE:
-							color = WHITE_COLOR;
-							break;
-						case CoreGame::Unit::BLACK:
-							color = BLACK_COLOR;
-							break;
-						default:
-							color = EMPTY_COLOR; //AVOID STUPID WARNING FROM GCC AS WELL
-					}
-					cursor_gotoxy({x * 2 + 1, y + 1});
-					background_color(color);
-					printf("  ");
-					color_reset();
+	void draw(console::Screen &screen, const CoreGame &g, UCoord selection_pos) {
+		assert(selection_pos.x < map_size.w || selection_pos.y < map_size.h);
+		screen.fill();
+		for(uint_type x = 0; x < map_size.w * 2 + 2; ++x) {
+			const char border = (x == 0 || x == map_size.w * 2 + 1) ? '|' : '-';
+			screen[{x, 0}].glyph = border;
+			screen[{x, map_size.h + 1}].glyph = border;
+		}
+		for(uint_type y = 0; y < map_size.h; ++y) {
+			screen[{0, y + 1}].glyph = '|';
+			screen[{map_size.w * 2 + 1, y + 1}].glyph = '|';
+			for(uint_type x = 0; x < map_size.w; ++x) {
+				console::CellColor color = unit_color(g[{x, y}]);
+				if(UCoord{x, y} == selection_pos && g[{x, y}] == CoreGame::Unit::EMPTY) {
+					color = SELECTION_COLOR;
 				}
+				screen[{x * 2 + 1, y + 1}].back = screen[{x * 2 + 2, y + 1}].back = color;
 			}
 		}
-		cursor_gotoxy({0, map_size.h + 2});
-	}
-
-	/*
-	 * Print selection.
-	 * The position of cursor is set to {0, MAP_SIZE.h + 2} after a call completes.
-	 */
-	void print_selection(const CoreGame &game, UCoord selection_pos, bool has_old_selection_pos = false, UCoord old_selection_pos = {0, 0}) {
-		assert(selection_pos.x < map_size.w || selection_pos.y < map_size.h);
-		if(game[selection_pos] != CoreGame::Unit::EMPTY) {
-			cursor_gotoxy({0, map_size.h + 2});
-			return;
-		};
 
-		if(has_old_selection_pos) { // Remove old selection
-			cursor_gotoxy({old_selection_pos.x * 2 + 1, old_selection_pos.y + 1});
-			switch(game[old_selection_pos]) {
-				case CoreGame::Unit::BLACK: background_color(BLACK_COLOR); break;
-				case CoreGame::Unit::WHITE: background_color(WHITE_COLOR); break;
-				case CoreGame::Unit::EMPTY: background_color(EMPTY_COLOR); break;
-			}
+		switch(g.status()) {
+			case CoreGame::Status::NONE:
+				screen.print({0, map_size.h + 2}, g.is_white_turn() ? "White's turn." : "Black's turn.");
+				break;
+			case CoreGame::Status::BLACK_WON:
+				screen.print({0, map_size.h + 3}, "Black won.");
+				break;
+			case CoreGame::Status::WHITE_WON:
+				screen.print({0, map_size.h + 3}, "White won.");
+				break;
 		}
-		printf("  ");
-		cursor_gotoxy({selection_pos.x * 2 + 1, selection_pos.y + 1}); // Print new selecion
-		background_color(SELECTION_COLOR);
-		printf("  ");
-		color_reset();
-		cursor_gotoxy({0, map_size.h + 2});
 	}
 
 
@@ -1643,51 +1759,53 @@ namespace frontend_with_console {
 
 	private:
 
-		CoreGame game, bufgame;
-		UCoord selection_pos, buf_selection_pos;
+		CoreGame game;
+		UCoord selection_pos;
+		console::Screen screen;
 	};
 
-	Game::Game() {
+	Game::Game()
+		: screen({std::max(map_size.w * 2 + 2, MINIMAL_SCREEN_WIDTH), map_size.h + 4}) {
 		selection_pos = {map_size.w / 2, map_size.h / 2};
-		buf_selection_pos = selection_pos;
 	}
 
 	void Game::start() {
-		screen_clear();
-		print(game);
-		printf("%s's turn.\n", game.is_white_turn() ? "White" : "Black");
-		print_selection(game, selection_pos);
+		{
+			console::Batch batch; // Clear the terminal along with the first frame
+			screen_clear();
+			draw(screen, game, selection_pos);
+			screen.present();
+		}
 
-		ArrowKeyPraser praser;
+		console::Keyboard keyboard;
 		while(true) {
-			unsigned char input = getch();
+			const std::optional<console::KeyPress> press = keyboard.read();
+			if(!press) return; // stdin has ended
 			Key key {};
-			auto praser_result = praser(input);
-			switch(praser_result.first) {
-				case ArrowKeyPraser::Status::MATCH:
-					key = key_from_console_key(praser_result.second);
+			switch(press->key) {
+				case console::Key::UP: case console::Key::DOWN: case console::Key::LEFT: case console::Key::RIGHT:
+					key = key_from_console_key(press->key);
 					break;
-				case ArrowKeyPraser::Status::MATCHING:
-					continue;
-				case ArrowKeyPraser::Status::MISMATCH:
+				case console::Key::CHARACTER:
+					switch(press->character < 0x80 ? toupper(int(press->character)) : 0) {
+						case 'A': case 'H': key = Key::LEFT; break;
+						case 'S': case 'J': key = Key::DOWN; break;
+						case 'W': case 'K': key = Key::UP; break;
+						case 'D': case 'L': key = Key::RIGHT; break;
+						case 'R': key = Key::RESET; break;
+						case 'P': key = Key::PRINT; break;
+						case 'Q': key = Key::QUIT; break;
+						case '\n': case ' ': key = Key::ENTER; break;
+						default: continue;
+					}
 					break;
-			}
-			if(praser_result.first == ArrowKeyPraser::Status::MISMATCH) {
-				switch(toupper(input)) {
-					case 'A': case 'H': key = Key::LEFT; break;
-					case 'S': case 'J': key = Key::DOWN; break;
-					case 'W': case 'K': key = Key::UP; break;
-					case 'D': case 'L': key = Key::RIGHT; break;
-					case 'R': key = Key::RESET; break;
-					case 'P': key = Key::PRINT; break;
-					case 'Q': key = Key::QUIT; break;
-					case '\n': case ' ': key = Key::ENTER; break;
-					default: continue;
-				}
+				case console::Key::RESIZE:
+					screen.present(); // Redraws everything for the new size
+					continue;
+				default:
+					continue;
 			}
 
-
-			bool if_print_diff = true;
 			if(key == Key::QUIT) {
 				return;
 			} else if(key == Key::ENTER) {
@@ -1716,7 +1834,7 @@ namespace frontend_with_console {
 				}
 				if(!reset_success) return;
 			} else if (key == Key::PRINT) {
-				if_print_diff = false;
+				screen.invalidate();
 			} else {
 				UCoord new_selection_pos = selection_pos;
 				auto inboard = [](UCoord c) -> bool {
@@ -1772,27 +1890,10 @@ namespace frontend_with_console {
 				}
 			}
 
-			if (if_print_diff) {
-				print_diff(game, bufgame);
-			} else {
-				console::cursor_reset();
-				print(game);
-			}
-			print_selection(game, selection_pos, true, buf_selection_pos);
-			bufgame = game;
-			buf_selection_pos = selection_pos;
+			draw(screen, game, selection_pos);
+			screen.present();
 
-			// Check game status
-			if(game.status() == CoreGame::Status::NONE) {
-				printf("%s's turn.\n", game.is_white_turn() ? "White" : "Black");
-			} else {
-				if(game.status() == CoreGame::Status::BLACK_WON) {
-					printf("\nBlack won.\n");
-				} else if(game.status() == CoreGame::Status::WHITE_WON) {
-					printf("\nWhite won.\n");
-				}
-				return;
-			}
+			if(game.status() != CoreGame::Status::NONE) return;
 		}
 	}
 }
@@ -1804,7 +1905,7 @@ namespace frontend_with_console {
 int process_argument(size_t argc, char **argv) {
 	ArgumentProcessor ap;
 
-	Argument help, map_size_arg, rows, switch_mode, enable_software_rendering, enable_trick_arg;
+	Argument help, map_size_arg, rows, switch_mode, enable_software_rendering, fps_arg, trace_out_arg, enable_trick_arg;
 
 	help.add_name("-h").add_name("--help").add_name("--usage");
 	help.set_argc(0);
@@ -1887,6 +1988,31 @@ int process_argument(size_t argc, char **argv) {
 		software_rendering = true;
 	});
 
+	fps_arg.add_name("--fps");
+	fps_arg.set_argc(1);
+	fps_arg.set_description("Limit the frame rate. 0 for synchronizing with the display(default). Available in graphic mode.");
+	fps_arg.set_act_func([] (char **argv) {
+		bool success;
+		int i = parse_int(argv[0], &success);
+
+		if(!success) {
+			log_error("Require an integer(\"%s\").", argv[0]);
+			exit(1);
+		}
+		if(i < 0) {
+			log_error("Require an integer not less than 0(\"%d\").", i);
+			exit(1);
+		}
+		target_fps = i;
+	});
+
+	trace_out_arg.add_name("--trace-out");
+	trace_out_arg.set_argc(1);
+	trace_out_arg.set_description("Dump the timing of the last frames in Chrome trace format to the specified file on exit. Available in graphic mode. Press F3 to show frame stats.");
+	trace_out_arg.set_act_func([] (char **argv) {
+		trace_out_path = argv[0];
+	});
+
 	enable_trick_arg.add_name("--enable-trick");
 	enable_trick_arg.set_argc(0);
 	enable_trick_arg.set_description("Enable a funny trick. But I don't think it is funny at all.");
@@ -1899,6 +2025,8 @@ int process_argument(size_t argc, char **argv) {
 	ap.register_argument(rows);
 	ap.register_argument(switch_mode);
 	ap.register_argument(enable_software_rendering);
+	ap.register_argument(fps_arg);
+	ap.register_argument(trace_out_arg);
 	ap.register_argument(enable_trick_arg);
 
 	return ap.process(argc, argv) ? 0 : 1;
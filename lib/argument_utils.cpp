@@ -1,15 +1,14 @@
 ﻿#include "argument_utils.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <exception>
-#include <map>
 #include <memory>
 #include <string_view>
 #include <vector>
 
-using std::map;
 using std::string;
 using std::string_view;
 using std::function;
@@ -17,16 +16,11 @@ using std::exception;
 using std::initializer_list;
 
 bool Argument::is_name(const char *name_) const {
-	for(const string &name : names) {
-		if(name == name_) {
-			return true;
-		}
-	}
-	return false;
+	return is_name(string(name_));
 }
 
 bool Argument::is_name(const string &name_) const {
-	return is_name(name_.c_str());
+	return names.find(name_) != names.end();
 }
 
 Argument& Argument::add_name(const string &name_) {
@@ -73,13 +67,23 @@ bool operator==(const Argument &lfs, const Argument &rfs) {
 
 bool ArgumentProcessor::register_argument(const Argument &given_arg) {
 	arguments.push_back(given_arg);
+	const Argument &arg = arguments.back();
+	for(const string &name : arg.names) {
+		// After the names already there, so that the first argument with a name is found, as when arguments were searched in order
+		const auto after = std::upper_bound(name_index.begin(), name_index.end(), string_view(name), [](string_view name, const IndexEntry &entry) {
+			return name < entry.name;
+		});
+		name_index.insert(after, {name, argument_index.size()});
+	}
+	argument_index.push_back(&arg);
 	return true;
 }
 void ArgumentProcessor::set_default_argument(const Argument &specified_arg) {
-	int index = 0;
+	size_t index = 0;
 	for(const Argument &arg : arguments) {
 		if(specified_arg == arg) {
 			default_argument_pointer = &arg;
+			default_argument_position = index;
 			return;
 		}
 		++index;
@@ -92,6 +96,16 @@ void ArgumentProcessor::set_default_argument(const Argument &specified_arg) {
 	throw ArgumentNotFoundException();
 }
 
+size_t ArgumentProcessor::find_argument(string_view name) const {
+	const auto found = std::lower_bound(name_index.begin(), name_index.end(), name, [](const IndexEntry &entry, string_view name) {
+		return entry.name < name;
+	});
+	if(found == name_index.end() || found->name != name) {
+		return npos;
+	}
+	return found->position;
+}
+
 bool ArgumentProcessor::process(size_t argc, char **argv) const {
 	if(arguments.empty()) {
 		return false;
@@ -100,7 +114,7 @@ bool ArgumentProcessor::process(size_t argc, char **argv) const {
 		size_t called_time = 0;
 		std::vector<size_t> arg_pos;
 	};
-	std::map<const Argument *, Temp> result;
+	std::vector<Temp> result(argument_index.size());
 
 	auto longest_name  = [](const Argument &arg) -> const char * {
 		const string *result_p = nullptr;
@@ -118,29 +132,21 @@ bool ArgumentProcessor::process(size_t argc, char **argv) const {
 			return nullptr;
 		}
 	};
-	auto find_argument = [this](const char *given_name) -> const Argument * {
-		for(const Argument &arg : arguments) {
-			if(arg.is_name(given_name)) {
-				return &arg;
-			}
-		}
-		return nullptr;
-	};
-
-	auto process_argument = [argc, argv, &find_argument, &result](const Argument &called_arg,
+	auto process_argument = [this, argc, argv, &result](size_t called_position,
 								   const char *called_arg_name,
 								   size_t start_index) -> bool {
+		const Argument &called_arg = *argument_index[called_position];
 		size_t given_argc = 0;
 		for(size_t k = start_index; k < argc; k++) {
 			if(given_argc == called_arg.argc) {
 				break;
 			}
-			if(strlen(argv[k]) == 0) {
+			if(argv[k][0] == '\0') {
 				++given_argc;
 				continue;
 			}
 			if(argv[k][0] == '-') {
-				if(!find_argument(argv[k])) {
+				if(find_argument(argv[k]) == npos) {
 					given_argc ++;
 					continue;
 				} else {
@@ -153,26 +159,26 @@ bool ArgumentProcessor::process(size_t argc, char **argv) const {
 			log_error("Argument \"%s\" requires %d sub parameter%s, but got %d.", called_arg_name, called_arg.argc, called_arg.argc < 2 ? "" : "s", given_argc);
 			return false;
 		}
-		if(result[&called_arg].called_time == called_arg.max_called_time) {
+		auto &temp = result[called_position];
+		if(temp.called_time == called_arg.max_called_time) {
 			log_error("\"%s\" was called more than a maximum of %d.", called_arg_name, called_arg.max_called_time);
 			return false;
 		}
-		auto &temp = result[&called_arg];
 		temp.arg_pos.push_back(start_index);
 		++temp.called_time;
 		return true;
 	};
 
 	for(size_t i = 1; i < argc; ++i) {
-		if(strlen(argv[i]) == 0) {
+		if(argv[i][0] == '\0') {
 			continue;
 		}
-		const Argument *find_result = find_argument(argv[i]);
-		if(find_result) {
-			const Argument &called_arg = *find_result;
+		const size_t found = find_argument(argv[i]);
+		if(found != npos) {
+			const Argument &called_arg = *argument_index[found];
 			const char *called_arg_name = argv[i];
 
-			if(!process_argument(called_arg, called_arg_name, i + 1)) return false;
+			if(!process_argument(found, called_arg_name, i + 1)) return false;
 
 			i += called_arg.argc;
 		} else {
@@ -190,14 +196,15 @@ bool ArgumentProcessor::process(size_t argc, char **argv) const {
 				called_arg_name = "";
 			}
 
-			if(!process_argument(called_arg, called_arg_name, i)) return false;
+			if(!process_argument(default_argument_position, called_arg_name, i)) return false;
 
 			i += called_arg.argc - 1;
 		}
 	}
-	for(const auto &arg : arguments) {
-		if(result.find(&arg) != result.end() && result[&arg].called_time != 0) {
-			const auto &temp = result[&arg];
+	for(size_t position = 0; position < argument_index.size(); ++position) {
+		const Argument &arg = *argument_index[position];
+		const auto &temp = result[position];
+		if(temp.called_time != 0) {
 			for(size_t i = 0; i < temp.called_time; ++i) {
 				if(arg.argc == 0) {
 					arg.act(argv);
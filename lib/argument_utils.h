@@ -8,6 +8,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_set>
+#include <vector>
 
 class Argument {
 	friend class ArgumentProcessor;
@@ -44,6 +45,24 @@ class ArgumentProcessor {
 private:
 	std::list<Argument> arguments;
 	const Argument *default_argument_pointer = nullptr;
+
+	size_t default_argument_position = npos;
+
+	/*
+	 * Every name of every argument, sorted, with the position of its argument in arguments,
+	 * so that each token is found by a binary search. Names given twice find the first argument.
+	 * Kept up to date by register_argument(), so that process() only reads it.
+	 */
+	struct IndexEntry {
+		std::string_view name;
+		size_t position;
+	};
+	std::vector<IndexEntry> name_index;
+	std::vector<const Argument *> argument_index; // arguments by position
+	/*
+	 * The position of the argument named name, or npos.
+	 */
+	size_t find_argument(std::string_view name) const;
 public:
 	bool register_argument(const Argument &given_arg);
 	void set_default_argument(const Argument &specified_arg);
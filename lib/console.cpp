@@ -3,3 +3,61 @@
 #else //UNIX
 #include "console_unix.cpp"
 #endif
+
+#include "console_width.cpp"
+
+#include <algorithm>
+
+namespace console {
+	Screen::Screen(Area size) :
+		m_size(size),
+		front(size.w * size.h),
+		back(size.w * size.h),
+		invalidated(true),
+		terminal(terminal_size()) {}
+
+	UCoord Screen::print(UCoord pos, std::string_view str, CellColor fore, CellColor back) {
+		assert(pos.y < m_size.h);
+		for(size_t index = 0; index < str.size() && pos.x < m_size.w; ) {
+			const char32_t c = next_utf8_char(str, index);
+			const int width = char_width(c);
+			if(width == 0) continue; // Combining characters can't have cells of their own
+			if(pos.x + width > m_size.w) break;
+
+			(*this)[pos] = {c, fore, back};
+			if(width == 2) (*this)[{pos.x + 1, pos.y}] = {0, fore, back};
+			pos.x += width;
+		}
+		return pos;
+	}
+
+	void Screen::fill(Cell c) {
+		std::fill(back.begin(), back.end(), c);
+	}
+
+	void Screen::resize(Area size) {
+		std::vector<Cell> new_back(size.w * size.h);
+		for(uint_type y = 0; y < std::min(size.h, m_size.h); ++y) {
+			std::copy_n(back.begin() + y * m_size.w, std::min(size.w, m_size.w), new_back.begin() + y * size.w);
+		}
+		back = std::move(new_back);
+		front.assign(size.w * size.h, Cell{});
+		m_size = size;
+		invalidated = true;
+		terminal = {0, 0}; // Clear what was drawn outside of the new size
+	}
+
+	uint_type Screen::run_start(UCoord pos) const {
+		if(pos.x == 0) return 0;
+		const size_t left = pos.y * m_size.w + pos.x - 1;
+		// Writing either half of a wide character on the terminal erases all of it
+		return char_width(front[left].glyph) == 2 || char_width(back[left].glyph) == 2 ? pos.x - 1 : pos.x;
+	}
+
+	char32_t Screen::shown_glyph(UCoord pos, uint_type right) const {
+		const char32_t glyph = back[pos.y * m_size.w + pos.x].glyph;
+		if(glyph == 0) return ' ';
+		if(char_width(glyph) == 2 && (pos.x + 1 >= right || back[pos.y * m_size.w + pos.x + 1].glyph != 0)) return ' ';
+		return glyph;
+	}
+}
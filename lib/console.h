@@ -3,12 +3,44 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cassert>
 #include <type_traits>
 #include <utility>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <vector>
 #include <utils.h>
 
 namespace console {
-	enum class ColorEnum : int8_t {RED, GREEN, BLUE, PURPLE, CYAN, WHITE, BLACK};
+	enum class ColorEnum : int8_t {RED, GREEN, BLUE, PURPLE, CYAN, WHITE, BLACK, DEFAULT};
+
+	/*
+	 * Either one of ColorEnum or an RGB color.
+	 * RGB colors are sent as they are to terminals with truecolor,
+	 * and downgraded to the nearest color the terminal supports otherwise.
+	 */
+	struct CellColor {
+		constexpr CellColor(ColorEnum c = ColorEnum::DEFAULT) : is_rgb(false), enum_value(c), rgb_value{0, 0, 0} {}
+		constexpr CellColor(Color3 c) : is_rgb(true), enum_value(ColorEnum::DEFAULT), rgb_value(c) {}
+		constexpr CellColor(Color c) : CellColor(Color3{c.r, c.g, c.b}) {} // Alpha is ignored
+
+		bool is_rgb;
+		ColorEnum enum_value;
+		Color3 rgb_value;
+	};
+	constexpr inline bool operator==(CellColor lfs, CellColor rfs) {
+		if(lfs.is_rgb != rfs.is_rgb) return false;
+		if(!lfs.is_rgb) return lfs.enum_value == rfs.enum_value;
+		return lfs.rgb_value.r == rfs.rgb_value.r && lfs.rgb_value.g == rfs.rgb_value.g && lfs.rgb_value.b == rfs.rgb_value.b;
+	}
+	constexpr inline bool operator!=(CellColor lfs, CellColor rfs) {return !(lfs == rfs);}
+
+	enum class ColorMode : uint8_t {BASIC /* 8 colors */, PALETTE_256, TRUECOLOR};
+	/*
+	 * The colors the terminal supports, detected from COLORTERM and TERM at the first call.
+	 */
+	ColorMode color_mode();
 
 	void cursor_reset();
 	void cursor_gotoxy(UCoord);
@@ -24,6 +56,16 @@ namespace console {
 	void screen_empty();
 	void screen_clear();
 
+	/*
+	 * The size of the terminal in cells.
+	 * It's only queried again after the terminal reports a resize, so calling this often is cheap.
+	 */
+	Area terminal_size();
+
+	/*
+	 * Colors are only sent when they differ from the current ones,
+	 * and fore and back colors changed together are combined into one escape.
+	 */
 	void foreground_color(Color);
 	void background_color(Color);
 
@@ -32,10 +74,182 @@ namespace console {
 	void color(ColorEnum fore, ColorEnum back);
 	void color_reset();
 
+	/*
+	 * While a Batch exists, what the functions above and std::cout output is kept in memory,
+	 * and written at once by flush() or when the outermost Batch is destroyed.
+	 * Outside of batches every function flushes its output immediately.
+	 * On Windows, where colors are not escapes, output is only flushed as usual.
+	 */
+	class Batch {
+	public:
+		Batch();
+		~Batch();
+		Batch(const Batch &) = delete;
+		Batch &operator=(const Batch &) = delete;
+	};
+	/*
+	 * Write what has been batched so far.
+	 */
+	void flush();
+
+	/*
+	 * The amount of cells a character takes in the terminal: 2 for wide East Asian characters,
+	 * 0 for combining and control characters and 1 for others. No locale is involved.
+	 */
+	int char_width(char32_t c);
+	/*
+	 * The amount of cells an UTF-8 string takes in the terminal.
+	 * Invalid bytes are counted as U+FFFD, which takes a cell.
+	 */
+	size_t display_width(std::string_view str);
+
+	/*
+	 * A character cell of the terminal.
+	 * A wide character is followed by a cell whose glyph is 0, which stands for its right half.
+	 */
+	struct Cell {
+		char32_t glyph = ' ';
+		CellColor fore, back;
+	};
+	constexpr inline bool operator==(Cell lfs, Cell rfs) {
+		return lfs.glyph == rfs.glyph && lfs.fore == rfs.fore && lfs.back == rfs.back;
+	}
+	constexpr inline bool operator!=(Cell lfs, Cell rfs) {return !(lfs == rfs);}
+
+	/*
+	 * A grid of cells covering the terminal from its topleft.
+	 * Drawing happens on the back buffer, while the front buffer holds what the terminal shows.
+	 * present() only sends the cells that differ, so games don't need to track changes themselves.
+	 */
+	class Screen {
+	public:
+		explicit Screen(Area size);
+
+		Area size() const {return m_size;}
+
+		/*
+		 * Access a cell of the back buffer.
+		 */
+		Cell &operator[](UCoord c) {
+			assert(c.x < m_size.w && c.y < m_size.h);
+			return back[c.y * m_size.w + c.x];
+		}
+		const Cell &operator[](UCoord c) const {
+			assert(c.x < m_size.w && c.y < m_size.h);
+			return back[c.y * m_size.w + c.x];
+		}
+		/*
+		 * Put an UTF-8 string on the back buffer, clipped at the right edge.
+		 * Wide characters take two cells, and combining ones are left out.
+		 * Return the coord after the last cell written.
+		 */
+		UCoord print(UCoord pos, std::string_view str, CellColor fore = {}, CellColor back = {});
+		/*
+		 * Set every cell of the back buffer.
+		 */
+		void fill(Cell c = {});
+		/*
+		 * Change the size of the screen, keeping the content of the back buffer that still fits.
+		 * The next present() clears the terminal and redraws every cell.
+		 */
+		void resize(Area size);
+
+		/*
+		 * Regard the content of the terminal as unknown, so that the next present() redraws every cell.
+		 * A new Screen is invalidated.
+		 */
+		void invalidate() {invalidated = true;}
+		/*
+		 * Send the cells of the back buffer that differ from the front buffer to the terminal.
+		 * Adjacent changed cells in a row are sent as a run after a single cursor movement,
+		 * and the whole frame is written at once.
+		 * Afterwards the cursor is at the beginning of the line below the screen, or of the last line of the terminal,
+		 * and colors are reset,
+		 * unless nothing changed, in which case nothing is written.
+		 * Cells outside of the terminal are left out. If the terminal has been resized since the last call,
+		 * it's cleared and everything is redrawn, once however many resizes happened in between.
+		 * Return the amount of bytes written.
+		 */
+		size_t present();
+	private:
+		Area m_size;
+		std::vector<Cell> front, back;
+		bool invalidated;
+		Area terminal; // The size of the terminal at the last present()
+
+		/*
+		 * Where a run of changed cells starting at pos has to start instead,
+		 * so that it never begins at the right half of a wide character.
+		 */
+		uint_type run_start(UCoord pos) const;
+		/*
+		 * The character to print for the cell of the back buffer at pos, if the row is visible up to right.
+		 * A wide character that is cut off, or the right half left on its own, is shown as a space.
+		 */
+		char32_t shown_glyph(UCoord pos, uint_type right) const;
+	};
+
 
 	enum class Key : uint8_t {
-		UP, DOWN, LEFT, RIGHT
+		UP, DOWN, LEFT, RIGHT,
+		HOME, END, INSERT, DEL /* DELETE is a macro of windows.h */, PAGE_UP, PAGE_DOWN,
+		F1, F2, F3, F4, F5, F6, F7, F8, F9, F10, F11, F12,
+		ESCAPE,
+		CHARACTER, // Any other character, including control ones
+		PASTE, // Text pasted while bracketed paste is on
+		RESIZE, // The terminal has been resized, see terminal_size()
+		UNKNOWN // An escape sequence that isn't understood
+	};
+	struct KeyPress {
+		KeyPress(Key k, char32_t c = 0, std::string t = {}) : key(k), character(c), text(std::move(t)) {}
+
+		Key key;
+		char32_t character = 0; // For Key::CHARACTER
+		std::string text; // For Key::PASTE
+	};
+
+	/*
+	 * Reads and decodes keys from stdin, with the terminal in raw mode while it exists.
+	 * Input is read in batches, so keys that arrive together cost one poll() and one read().
+	 * A lone escape is told from the beginning of a sequence by waiting escape_timeout_ms for the rest.
+	 * Resizes of the terminal are reported as Key::RESIZE, once the window has stopped changing for a moment,
+	 * so that a drag causes a single redraw.
+	 */
+	class Keyboard {
+	public:
+		constexpr static int DEFAULT_ESCAPE_TIMEOUT_MS = 50;
+
+		explicit Keyboard(int escape_timeout_ms = DEFAULT_ESCAPE_TIMEOUT_MS);
+
+		/*
+		 * Wait up to timeout_ms, or forever if it's negative, for a key.
+		 * Return nothing if no key came in time or stdin ended.
+		 */
+		std::optional<KeyPress> read(int timeout_ms = -1);
+	private:
+		/*
+		 * Wait up to timeout_ms for input and append what's available to pending.
+		 * A resize of the terminal sets resized.
+		 * Return false if nothing came.
+		 */
+		bool fill(int timeout_ms);
+		/*
+		 * Decode the key at the beginning of pending and remove it.
+		 * Return nothing if the key is incomplete, unless complete is true,
+		 * which means no more input is coming and the key is decoded as is.
+		 */
+		std::optional<KeyPress> decode(bool complete);
+
+		RawMode raw_mode;
+		int escape_timeout;
+		std::string pending;
+		bool resized = false;
 	};
+	/*
+	 * Ask the terminal to mark pasted text, which Keyboard then reads as one Key::PASTE.
+	 */
+	void bracketed_paste(bool enable);
+
 	struct ArrowKeyPraser {
 	public:
 		enum class Status : uint8_t {
@@ -1,142 +1,469 @@
 #include "console.h"
 
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <optional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <csignal>
+#include <sys/ioctl.h>
 
 using std::cout;
-using std::flush;
 
-const char *get_colorenum_id(console::ColorEnum c) {
-	using console::ColorEnum;
+using console::ColorEnum;
+using console::CellColor;
+using console::ColorMode;
+
+uint8_t colorenum_index(ColorEnum c) {
 	switch(c) {
 		case ColorEnum::RED:
-			return "1";
+			return 1;
 		case ColorEnum::GREEN:
-			return "2";
+			return 2;
 		case ColorEnum::BLUE:
-			return "4";
+			return 4;
 		case ColorEnum::PURPLE:
-			return "5";
+			return 5;
 		case ColorEnum::CYAN:
-			return "6";
+			return 6;
 		case ColorEnum::WHITE:
-			return "7";
+			return 7;
 		case ColorEnum::BLACK:
-			return "0";
+			return 0;
+		case ColorEnum::DEFAULT:
+			return 9;
 	}
-	return "";
+	return 9;
+}
+
+/*
+ * The nearest color of the 6x6x6 cube or the grayscale ramp of the 256-color palette.
+ */
+uint8_t nearest_palette_index(Color3 c) {
+	constexpr int LEVELS[] = {0, 95, 135, 175, 215, 255};
+	auto level = [](int v) -> int {return v < 48 ? 0 : v < 115 ? 1 : (v - 35) / 40;};
+	auto distance = [c](int r, int g, int b) -> int {
+		return (c.r - r) * (c.r - r) + (c.g - g) * (c.g - g) + (c.b - b) * (c.b - b);
+	};
+
+	const int r = level(c.r), g = level(c.g), b = level(c.b);
+	const int cube_index = 16 + 36 * r + 6 * g + b;
+	const int cube_distance = distance(LEVELS[r], LEVELS[g], LEVELS[b]);
+
+	const int average = (c.r + c.g + c.b) / 3;
+	const int gray = average > 238 ? 23 : std::max(average - 3, 0) / 10;
+	const int gray_level = 8 + 10 * gray;
+	const int gray_distance = distance(gray_level, gray_level, gray_level);
+
+	return gray_distance < cube_distance ? 232 + gray : cube_index;
+}
+
+/*
+ * A color as it's sent in SGR parameters, after being downgraded to the color mode.
+ */
+struct SgrColor {
+	enum Type : uint8_t {UNKNOWN, BASIC, INDEXED, RGB} type = UNKNOWN;
+	uint8_t r = 0, g = 0, b = 0; // r holds the index for BASIC and INDEXED
+};
+constexpr inline bool operator==(SgrColor lfs, SgrColor rfs) {
+	return lfs.type == rfs.type && lfs.r == rfs.r && lfs.g == rfs.g && lfs.b == rfs.b;
+}
+constexpr inline bool operator!=(SgrColor lfs, SgrColor rfs) {return !(lfs == rfs);}
+constexpr SgrColor SGR_DEFAULT = {SgrColor::BASIC, 9};
+
+// The colors of the terminal as far as known, so that only the changed ones are sent.
+SgrColor sgr_fore, sgr_back;
+
+SgrColor sgr_color(CellColor c) {
+	if(!c.is_rgb) return {SgrColor::BASIC, colorenum_index(c.enum_value)};
+	const Color3 rgb = c.rgb_value;
+	switch(console::color_mode()) {
+		case ColorMode::TRUECOLOR:
+			return {SgrColor::RGB, rgb.r, rgb.g, rgb.b};
+		case ColorMode::PALETTE_256:
+			return {SgrColor::INDEXED, nearest_palette_index(rgb)};
+		case ColorMode::BASIC:
+			break;
+	}
+	return {SgrColor::BASIC, uint8_t((rgb.r >= 128) | (rgb.g >= 128) << 1 | (rgb.b >= 128) << 2)};
+}
+
+void append_sgr_parameter(std::string &output, bool foreground, SgrColor c) {
+	output += foreground ? '3' : '4';
+	switch(c.type) {
+		case SgrColor::BASIC:
+			output += char('0' + c.r);
+			break;
+		case SgrColor::INDEXED:
+			output += "8;5;";
+			output += std::to_string(c.r);
+			break;
+		case SgrColor::RGB:
+			output += "8;2;";
+			output += std::to_string(c.r);
+			output += ';';
+			output += std::to_string(c.g);
+			output += ';';
+			output += std::to_string(c.b);
+			break;
+		case SgrColor::UNKNOWN:
+			break;
+	}
+}
+/*
+ * Append an escape switching the terminal to fore and back, with only the parameters that change.
+ * An UNKNOWN color is left as it is.
+ */
+void append_sgr(std::string &output, SgrColor fore, SgrColor back) {
+	const bool override_fore = fore.type != SgrColor::UNKNOWN && fore != sgr_fore;
+	const bool override_back = back.type != SgrColor::UNKNOWN && back != sgr_back;
+	if(!override_fore && !override_back) return;
+
+	output += "\033[";
+	if(override_fore) {
+		append_sgr_parameter(output, true, fore);
+		sgr_fore = fore;
+	}
+	if(override_fore && override_back) output += ';';
+	if(override_back) {
+		append_sgr_parameter(output, false, back);
+		sgr_back = back;
+	}
+	output += 'm';
+}
+void append_sgr_reset(std::string &output) {
+	if(sgr_fore == SGR_DEFAULT && sgr_back == SGR_DEFAULT) return;
+	output += "\033[0m";
+	sgr_fore = sgr_back = SGR_DEFAULT;
+}
+std::stringbuf batch_buffer; // Takes the place of the buffer of cout during batches
+std::streambuf *stdout_buffer = nullptr; // The buffer of cout outside batches
+unsigned batch_depth = 0;
+
+/*
+ * Write all of str to stdout with as few syscalls as possible, after what stdio holds.
+ */
+void write_all(std::string_view str) {
+	cout << std::flush;
+	std::fflush(stdout);
+	size_t written = 0;
+	while(written < str.size()) {
+		ssize_t result = write(STDOUT_FILENO, str.data() + written, str.size() - written);
+		if(result < 0) {
+			if(errno == EINTR) continue;
+			return;
+		}
+		written += result;
+	}
+}
+
+/*
+ * The position of the cursor is only known inside a batch, as long as nothing but lib/console has been
+ * written since it was recorded: text printed through cout moves the cursor, and once the batch reaches
+ * the terminal, typed characters may be echoed.
+ */
+UCoord cursor;
+std::streamoff cursor_mark = -1; // The size of the batch when cursor was recorded
+
+std::streamoff batch_size() {
+	return batch_buffer.pubseekoff(0, std::ios_base::cur, std::ios_base::out);
+}
+std::optional<UCoord> known_cursor() {
+	if(batch_depth == 0 || cursor_mark != batch_size()) return {};
+	return cursor;
+}
+void set_cursor(std::optional<UCoord> c) {
+	if(c && batch_depth != 0) {
+		cursor = *c;
+		cursor_mark = batch_size();
+	} else {
+		cursor_mark = -1;
+	}
+}
+
+void write_batch() {
+	const std::string str = batch_buffer.str();
+	batch_buffer.str({});
+	cursor_mark = -1;
+	write_all(str);
+}
+
+/*
+ * Output an escape that doesn't move the cursor.
+ */
+void output_control(std::string_view str) {
+	if(str.empty()) return;
+	const std::optional<UCoord> c = known_cursor();
+	cout << str << std::flush;
+	set_cursor(c);
+}
+void output_sgr(SgrColor fore, SgrColor back) {
+	std::string output;
+	append_sgr(output, fore, back);
+	output_control(output);
+}
+
+/*
+ * Append a CSI sequence with a count, which is omitted when it's 1.
+ */
+void append_csi(std::string &output, uint_type n, char final) {
+	output += "\033[";
+	if(n != 1) output += std::to_string(n);
+	output += final;
+}
+void append_cup(std::string &output, UCoord to) {
+	output += "\033[";
+	if(to != UCoord{0, 0}) output += std::to_string(to.y + 1);
+	if(to.x != 0) {
+		output += ';';
+		output += std::to_string(to.x + 1);
+	}
+	output += 'H';
+}
+void append_horizontal_move(std::string &output, uint_type from, uint_type to, std::string_view reprint) {
+	constexpr uint_type MAX_BACKSPACES = 2; // "\033[3D" is as long as 3 backspaces
+	if(to > from) {
+		std::string forward;
+		append_csi(forward, to - from, 'C');
+		output += !reprint.empty() && reprint.size() < forward.size() ? reprint : forward;
+	} else if(to < from) {
+		if(from - to <= MAX_BACKSPACES) output.append(from - to, '\b');
+		else append_csi(output, from - to, 'D');
+	}
+}
+/*
+ * Append the shortest sequence that moves the cursor from `from` to `to`.
+ * Either an absolute CUP, relative CUU/CUD/CUF/CUB, backspaces, CR and LF,
+ * or, on the same row, reprinting the cells in between whose content is given by reprint.
+ * If the column of from is not known, e.g. after writing the last column, only CR or CUP is used.
+ */
+void append_cursor_move(std::string &output, std::optional<UCoord> from, bool column_known, UCoord to, std::string_view reprint = {}) {
+	std::string best;
+	append_cup(best, to);
+	if(!from) {
+		output += best;
+		return;
+	}
+
+	auto consider = [&best](std::string &&candidate) {
+		if(candidate.size() < best.size()) best = std::move(candidate);
+	};
+	if(column_known) { // Vertical then horizontal
+		std::string candidate;
+		if(to.y < from->y) append_csi(candidate, from->y - to.y, 'A');
+		else if(to.y > from->y) append_csi(candidate, to.y - from->y, 'B');
+		append_horizontal_move(candidate, from->x, to.x, to.y == from->y ? reprint : std::string_view{});
+		consider(std::move(candidate));
+	}
+	{ // Carriage return, then down with line feeds or up, then right
+		std::string candidate = "\r";
+		if(to.y < from->y) {
+			append_csi(candidate, from->y - to.y, 'A');
+		} else if(to.y > from->y) {
+			// Line feeds may also return the carriage, which is where the cursor already is.
+			if(to.y - from->y < 3) candidate.append(to.y - from->y, '\n');
+			else append_csi(candidate, to.y - from->y, 'B');
+		}
+		append_horizontal_move(candidate, 0, to.x, {});
+		consider(std::move(candidate));
+	}
+	output += best;
+}
+
+/*
+ * Move the cursor to `to` and record its position.
+ */
+void output_cursor_move(UCoord to) {
+	std::string output;
+	append_cursor_move(output, known_cursor(), true, to);
+	cout << output << std::flush;
+	set_cursor(to);
+}
+/*
+ * Move the cursor relatively. Coordinates that would be negative are clamped, as terminals do.
+ */
+void output_relative_cursor_move(Coord offset) {
+	if(offset == Coord{0, 0}) return;
+	if(const std::optional<UCoord> c = known_cursor()) {
+		output_cursor_move({
+			offset.x < 0 && uint_type(-offset.x) > c->x ? 0 : c->x + offset.x,
+			offset.y < 0 && uint_type(-offset.y) > c->y ? 0 : c->y + offset.y
+		});
+		return;
+	}
+	std::string output;
+	if(offset.y < 0) append_csi(output, -offset.y, 'A');
+	else if(offset.y > 0) append_csi(output, offset.y, 'B');
+	if(offset.x < 0) append_csi(output, -offset.x, 'D');
+	else if(offset.x > 0) append_csi(output, offset.x, 'C');
+	cout << output << std::flush;
+}
+
+/*
+ * SIGWINCH is turned into a byte on a pipe, so that Keyboard can wait for it together with input.
+ */
+volatile sig_atomic_t terminal_size_changed = 1;
+int resize_pipe[2] = {-1, -1};
+constexpr int RESIZE_SETTLE_MS = 50; // A resize is reported after this long without another one
+
+void on_resize(int) {
+	const int saved_errno = errno;
+	terminal_size_changed = 1;
+	if(resize_pipe[1] >= 0) {
+		[[maybe_unused]] ssize_t result = write(resize_pipe[1], "", 1);
+	}
+	errno = saved_errno;
+}
+void watch_resize() {
+	static bool watching = false;
+	if(watching) return;
+	watching = true;
+
+	if(pipe(resize_pipe) == 0) {
+		for(int fd : resize_pipe) {
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+		}
+	} else {
+		resize_pipe[0] = resize_pipe[1] = -1;
+	}
+	struct sigaction action = {};
+	action.sa_handler = on_resize;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGWINCH, &action, nullptr);
+}
+/*
+ * Empty the resize pipe, and keep doing so until the terminal has stopped changing for RESIZE_SETTLE_MS.
+ */
+void drain_resize_pipe() {
+	pollfd fd = {resize_pipe[0], POLLIN, 0};
+	int result;
+	do {
+		char buffer[64];
+		while(read(resize_pipe[0], buffer, sizeof(buffer)) > 0);
+		result = poll(&fd, 1, RESIZE_SETTLE_MS);
+	} while(result > 0 || (result < 0 && errno == EINTR)); // SIGWINCH itself interrupts poll()
 }
-using console::ColorEnum;
-ColorEnum fore_color, back_color;
-bool fore_unknown = true, back_unknown = true, reset = false;
 
 namespace console {
 
+	Batch::Batch() {
+		if(batch_depth++ == 0) {
+			cout << std::flush;
+			stdout_buffer = cout.rdbuf(&batch_buffer);
+		}
+	}
+	Batch::~Batch() {
+		if(--batch_depth == 0) {
+			write_batch();
+			cout.rdbuf(stdout_buffer);
+		}
+	}
+	void flush() {
+		if(batch_depth == 0) {
+			cout << std::flush;
+		} else {
+			write_batch();
+		}
+	}
+
 	void cursor_reset() {
-		cout << "\033[1;1H" << flush;
+		output_cursor_move({0, 0});
 	}
 	void cursor_gotoxy(UCoord coord) {
-		cout << "\033[" << coord.y + 1 << ";" << coord.x + 1 << "H" << flush;
+		output_cursor_move(coord);
 	}
 	void cursor_move(Coord coord) {
-		if(coord == Coord{0, 0}) return;
-		if(coord.x == 0) {cursor_down(coord.y); return;}
-		if(coord.y == 0) {cursor_right(coord.x); return;}
-		cout << "\033[";
-		if(coord.x > 0) cout << coord.x << "C";
-		else cout << -coord.x << "D";
-		cout << "\033[";
-		if(coord.y > 0) cout << coord.y << "A";
-		else cout << -coord.y << "B";
-		cout << flush;
+		output_relative_cursor_move(coord);
 	}
 	void cursor_move(UCoord coord) {
-		if(coord == UCoord{0, 0}) return;
-		if(coord.x == 0) {cursor_down(coord.y); return;}
-		if(coord.y == 0) {cursor_right(coord.x); return;}
-		cout << "\033[" <<  coord.x << "C" << "\033[" << coord.y << "B";
-		cout << flush;
+		output_relative_cursor_move({int_type(coord.x), int_type(coord.y)});
 	}
 	void cursor_down(int_type i) {
-		if(i > 0) {
-			cout << "\033[" << i << "B" << flush;
-		} else if(i < 0) {
-			cout << "\033[" << -i << "A" << flush;
-		}
+		output_relative_cursor_move({0, i});
 	}
 	void cursor_right(int_type i) {
-		if(i > 0) {
-			cout << "\033[" << i << "C" << flush;
-		} else if(i < 0) {
-			cout << "\033[" << -i << "D" << flush;
-		}
+		output_relative_cursor_move({i, 0});
 	}
+	std::optional<UCoord> saved_cursor;
 	void cursor_pos_save() {
-		cout << "\033[s" << flush;
+		saved_cursor = known_cursor();
+		output_control("\033[s");
 	}
 	void cursor_pos_reload() {
-		cout << "\033[u" << flush;
+		cout << "\033[u" << std::flush;
+		set_cursor(saved_cursor);
 	}
 	Coord cursor_pos();
 	void cursor_set_visible(bool b) {
-		cout << (b ? "\033[?25h" : "\033[?25l") << flush;
+		output_control(b ? "\033[?25h" : "\033[?25l");
 	}
 
 	void screen_empty() {
-		cout << "\033[2J" << flush;
+		output_control("\033[2J");
 	}
 	void screen_clear() {
-		cout << "\033[1;1H" << "\033[2J" << flush;
+		cout << "\033[H\033[2J" << std::flush;
+		set_cursor(UCoord{0, 0});
 	}
 
-	void foreground_color(ColorEnum c) {
-		reset = false;
-		if(fore_unknown) {
-			fore_unknown = false;
-		} else if(c == fore_color) {
-			return;
-		}
-		fore_color = c;
-		cout << "\033[3" << get_colorenum_id(c) << "m" << flush;
-	}
-	void background_color(ColorEnum c) {
-		reset = false;
-		if(back_unknown) {
-			back_unknown = false;
-		} else if(c == back_color) {
-			return;
+	Area terminal_size() {
+		constexpr Area FALLBACK_SIZE = {80, 24};
+		static Area size;
+		watch_resize();
+		if(terminal_size_changed) {
+			terminal_size_changed = 0;
+			winsize ws;
+			if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col != 0 && ws.ws_row != 0) {
+				size = {ws.ws_col, ws.ws_row};
+			} else {
+				size = FALLBACK_SIZE;
+			}
 		}
-		back_color = c;
-		cout << "\033[4" << get_colorenum_id(c) << "m" << flush;
+		return size;
 	}
 
-	void foreground_color(Color);
-	void background_color(Color);
+	ColorMode color_mode() {
+		static const ColorMode mode = []() -> ColorMode {
+			const char *colorterm = std::getenv("COLORTERM");
+			if(colorterm && (std::strcmp(colorterm, "truecolor") == 0 || std::strcmp(colorterm, "24bit") == 0)) {
+				return ColorMode::TRUECOLOR;
+			}
+			const char *term = std::getenv("TERM");
+			if(term && std::strstr(term, "-direct")) return ColorMode::TRUECOLOR;
+			if(term && std::strstr(term, "256color")) return ColorMode::PALETTE_256;
+			return ColorMode::BASIC;
+		}();
+		return mode;
+	}
 
+	void foreground_color(Color c) {
+		output_sgr(sgr_color(c), {});
+	}
+	void background_color(Color c) {
+		output_sgr({}, sgr_color(c));
+	}
+	void foreground_color(ColorEnum c) {
+		output_sgr(sgr_color(c), {});
+	}
+	void background_color(ColorEnum c) {
+		output_sgr({}, sgr_color(c));
+	}
 	void color(ColorEnum fore, ColorEnum back) {
-		reset = false;
-		bool override_fore = true, override_back = true;
-		if(!fore_unknown && fore_color == fore) override_fore = false;
-		if(!back_unknown && back_color == back) override_back = false;
-		fore_unknown = false;
-		back_unknown = false;
-		fore_color = fore;
-		back_color = back;
-
-		if(override_fore && override_back) {
-			cout << "\033[3" << get_colorenum_id(fore) << ";4" << get_colorenum_id(back) << "m" << flush;
-		} else if(override_fore) {
-			cout << "\033[3" << get_colorenum_id(fore) << "m" << flush;
-		} else if(override_back) {
-			cout << "\033[4" << get_colorenum_id(back) << "m" << flush;
-		}
+		output_sgr(sgr_color(fore), sgr_color(back));
 	}
 	void color_reset() {
-		if(!reset) {
-			cout << "\033[0m" << flush;
-			reset = true;
-			fore_unknown = true;
-			back_unknown = true;
-		}
+		std::string output;
+		append_sgr_reset(output);
+		output_control(output);
 	}
 	auto ArrowKeyPraser::operator()(unsigned char c) -> std::pair<Status, Key> {
 		if(c == '\033' && arrow_key_level == 0) {//UNIX CONSOLE ARROW KEY
@@ -159,4 +486,244 @@ namespace console {
 		}
 		return {};
 	}
+
+	/*
+	 * Keys of "\033[<n>~" sequences, indexed by n.
+	 */
+	constexpr Key tilde_key(unsigned n) {
+		switch(n) {
+			case 1: case 7: return Key::HOME;
+			case 2: return Key::INSERT;
+			case 3: return Key::DEL;
+			case 4: case 8: return Key::END;
+			case 5: return Key::PAGE_UP;
+			case 6: return Key::PAGE_DOWN;
+			case 11: return Key::F1;
+			case 12: return Key::F2;
+			case 13: return Key::F3;
+			case 14: return Key::F4;
+			case 15: return Key::F5;
+			case 17: return Key::F6;
+			case 18: return Key::F7;
+			case 19: return Key::F8;
+			case 20: return Key::F9;
+			case 21: return Key::F10;
+			case 23: return Key::F11;
+			case 24: return Key::F12;
+		}
+		return Key::UNKNOWN;
+	}
+	/*
+	 * Keys of "\033[<c>" and "\033O<c>" sequences.
+	 */
+	constexpr Key final_key(char c) {
+		switch(c) {
+			case 'A': return Key::UP;
+			case 'B': return Key::DOWN;
+			case 'C': return Key::RIGHT;
+			case 'D': return Key::LEFT;
+			case 'H': return Key::HOME;
+			case 'F': return Key::END;
+			case 'P': return Key::F1;
+			case 'Q': return Key::F2;
+			case 'R': return Key::F3;
+			case 'S': return Key::F4;
+		}
+		return Key::UNKNOWN;
+	}
+
+	constexpr std::string_view PASTE_BEGIN = "\033[200~", PASTE_END = "\033[201~";
+	constexpr int PASTE_TIMEOUT_MS = 1000; // Pasted text may come in several reads
+
+	Keyboard::Keyboard(int escape_timeout_ms) : escape_timeout(escape_timeout_ms) {
+		watch_resize();
+	}
+
+	std::optional<KeyPress> Keyboard::read(int timeout_ms) {
+		while(true) {
+			if(pending.empty()) {
+				if(resized) {
+					resized = false;
+					return KeyPress(Key::RESIZE);
+				}
+				if(!fill(timeout_ms)) return {};
+				continue;
+			}
+			if(std::optional<KeyPress> key = decode(false)) return key;
+			// Wait for the rest of an incomplete key
+			const bool pasting = pending.compare(0, PASTE_BEGIN.size(), PASTE_BEGIN) == 0;
+			if(!fill(pasting ? PASTE_TIMEOUT_MS : escape_timeout)) return decode(true);
+		}
+	}
+
+	bool Keyboard::fill(int timeout_ms) {
+		pollfd fds[] = {{STDIN_FILENO, POLLIN, 0}, {resize_pipe[0], POLLIN, 0}};
+		int result;
+		do {
+			result = poll(fds, resize_pipe[0] >= 0 ? 2 : 1, timeout_ms);
+		} while(result < 0 && errno == EINTR);
+		if(result <= 0) return false;
+		if(fds[1].revents & POLLIN) {
+			drain_resize_pipe();
+			resized = true;
+		}
+		if(fds[0].revents == 0) return true;
+
+		char buffer[1024];
+		ssize_t length;
+		do {
+			length = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+		} while(length < 0 && errno == EINTR);
+		if(length <= 0) return false;
+		pending.append(buffer, length);
+		return true;
+	}
+
+	std::optional<KeyPress> Keyboard::decode(bool complete) {
+		assert(!pending.empty());
+		auto consume = [this](size_t length, KeyPress key) -> std::optional<KeyPress> {
+			pending.erase(0, length);
+			return key;
+		};
+
+		const unsigned char first = pending[0];
+		if(first != '\033') {
+			int length = 1;
+			if(first >= 0xF0) length = 4;
+			else if(first >= 0xE0) length = 3;
+			else if(first >= 0xC0) length = 2;
+			if(pending.size() < size_t(length)) {
+				if(!complete) return {};
+				return consume(1, {Key::UNKNOWN});
+			}
+			int decoded_length;
+			const char32_t c = utf8to32(pending.data(), &decoded_length);
+			if(decoded_length == 0) return consume(1, {Key::UNKNOWN});
+			return consume(decoded_length, {Key::CHARACTER, c});
+		}
+
+		if(pending.size() == 1) {
+			if(!complete) return {};
+			return consume(1, {Key::ESCAPE});
+		}
+		if(pending[1] == 'O') { // SS3
+			if(pending.size() == 2) {
+				if(!complete) return {};
+				return consume(1, {Key::ESCAPE});
+			}
+			return consume(3, {final_key(pending[2])});
+		}
+		if(pending[1] != '[') return consume(1, {Key::ESCAPE});
+
+		// CSI: parameters, intermediates, then a final byte
+		size_t end = 2;
+		while(end < pending.size() && pending[end] >= 0x20 && pending[end] <= 0x3F) ++end;
+		if(end == pending.size()) {
+			if(!complete) return {};
+			return consume(1, {Key::ESCAPE});
+		}
+		if(pending[end] < 0x40 || pending[end] > 0x7E) return consume(1, {Key::ESCAPE});
+		const std::string_view parameters(pending.data() + 2, end - 2);
+		const char final = pending[end];
+		const size_t length = end + 1;
+
+		if(final != '~') {
+			// Modified keys like "\033[1;5A" are read as the plain ones.
+			return consume(length, {final_key(final)});
+		}
+		unsigned n = 0;
+		for(char c : parameters) {
+			if(c < '0' || c > '9') break;
+			n = n * 10 + (c - '0');
+		}
+		if(n == 200) {
+			const size_t paste_end = pending.find(PASTE_END, length);
+			if(paste_end == std::string::npos) {
+				if(!complete) return {};
+				return consume(pending.size(), {Key::PASTE, 0, pending.substr(length)});
+			}
+			return consume(paste_end + PASTE_END.size(), {Key::PASTE, 0, pending.substr(length, paste_end - length)});
+		}
+		return consume(length, {tilde_key(n)});
+	}
+
+	void bracketed_paste(bool enable) {
+		output_control(enable ? "\033[?2004h" : "\033[?2004l");
+	}
+
+	size_t Screen::present() {
+		constexpr uint_type MAX_REPRINT = 3; // Reprinting more cells never beats "\033[nC"
+		std::string output;
+		std::optional<UCoord> position = known_cursor();
+		bool column_known = true;
+
+		const Area current_terminal = terminal_size();
+		if(current_terminal != terminal) {
+			terminal = current_terminal;
+			invalidated = true;
+			append_sgr_reset(output); // Otherwise the terminal is cleared with the current background
+			output += "\033[H\033[2J";
+			position = UCoord{0, 0};
+		}
+		const Area visible = {std::min(m_size.w, terminal.w), std::min(m_size.h, terminal.h)};
+
+		for(uint_type y = 0; y < visible.h; ++y) {
+			uint_type x = 0;
+			while(x < visible.w) {
+				if(!invalidated && front[y * m_size.w + x] == back[y * m_size.w + x]) {
+					++x;
+					continue;
+				}
+
+				// Start of a run. The unchanged cells before it may be cheaper to print again than to skip.
+				const uint_type start = run_start({x, y});
+				x = start;
+				std::string reprint;
+				if(position && column_known && position->y == y && position->x < x && x - position->x <= MAX_REPRINT) {
+					for(uint_type i = position->x; i < x; ++i) {
+						const Cell &c = front[y * m_size.w + i];
+						if(sgr_color(c.fore) != sgr_fore || sgr_color(c.back) != sgr_back || char_width(c.glyph) != 1) {
+							reprint.clear();
+							break;
+						}
+						char glyph[4];
+						reprint.append(glyph, utf32to8(c.glyph, glyph));
+					}
+				}
+				append_cursor_move(output, position, column_known, {x, y}, reprint);
+
+				for(; x < visible.w; ++x) {
+					const size_t index = y * m_size.w + x;
+					const Cell c = back[index];
+					if(x != start && !invalidated && front[index] == c) break;
+
+					append_sgr(output, sgr_color(c.fore), sgr_color(c.back));
+
+					const char32_t shown = shown_glyph({x, y}, visible.w);
+					char glyph[4];
+					output.append(glyph, utf32to8(shown, glyph));
+					front[index] = c;
+					if(char_width(shown) == 2) {
+						++x;
+						front[index + 1] = back[index + 1];
+					}
+				}
+				position = UCoord{x, y};
+				column_known = x < terminal.w; // Terminals differ on where the cursor is after the last column
+			}
+		}
+		invalidated = false;
+		if(output.empty()) return 0;
+
+		const UCoord end = {0, std::min(m_size.h, terminal.h - 1)};
+		append_sgr_reset(output);
+		append_cursor_move(output, position, column_known, end);
+		if(batch_depth == 0) {
+			write_all(output);
+		} else {
+			cout << output;
+			set_cursor(end);
+		}
+		return output.size();
+	}
 }
@@ -1,10 +1,16 @@
 #include "console.h"
 
+#ifndef NOMINMAX
+#define NOMINMAX // Keep std::min and std::max usable
+#endif
 #include <windows.h>
 #include <conio.h>
 #include <cstdlib>
+#include <iostream>
+#include <algorithm>
 
 using console::ColorEnum;
+using console::CellColor;
 
 WORD get_foreground_color_id(ColorEnum c) {
 	switch(c) {
@@ -22,6 +28,8 @@ WORD get_foreground_color_id(ColorEnum c) {
 			return FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE;
 		case ColorEnum::BLACK:
 			return 0x0;
+		case ColorEnum::DEFAULT:
+			return FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE;
 	}
 	throw "";
 	return FOREGROUND_RED;
@@ -42,17 +50,48 @@ WORD get_background_color_id(ColorEnum c) {
 		case ColorEnum::WHITE:
 			return BACKGROUND_RED | BACKGROUND_GREEN | BACKGROUND_BLUE;
 		case ColorEnum::BLACK:
+		case ColorEnum::DEFAULT:
 			return 0x0;
 	}
 	throw "";
 	return BACKGROUND_GREEN;
 }
 
+/*
+ * RGB colors are downgraded to the 8 colors of the console.
+ */
+WORD get_foreground_color_id(CellColor c) {
+	if(!c.is_rgb) return get_foreground_color_id(c.enum_value);
+	return (c.rgb_value.r >= 128 ? FOREGROUND_RED : 0) | (c.rgb_value.g >= 128 ? FOREGROUND_GREEN : 0) | (c.rgb_value.b >= 128 ? FOREGROUND_BLUE : 0);
+}
+WORD get_background_color_id(CellColor c) {
+	if(!c.is_rgb) return get_background_color_id(c.enum_value);
+	return (c.rgb_value.r >= 128 ? BACKGROUND_RED : 0) | (c.rgb_value.g >= 128 ? BACKGROUND_GREEN : 0) | (c.rgb_value.b >= 128 ? BACKGROUND_BLUE : 0);
+}
+
 namespace console {
 	HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
 	COORD coord_saved;
-	ColorEnum fore_color = ColorEnum::WHITE, back_color = ColorEnum::BLACK;
+	CellColor fore_color = ColorEnum::WHITE, back_color = ColorEnum::BLACK;
+	bool color_known = false;
 
+	/*
+	 * Only call the console when the attributes change.
+	 */
+	void set_color(CellColor fore, CellColor back) {
+		if(color_known && fore == fore_color && back == back_color) return;
+		SetConsoleTextAttribute(handle, get_foreground_color_id(fore) | get_background_color_id(back));
+		fore_color = fore;
+		back_color = back;
+		color_known = true;
+	}
+
+
+	Batch::Batch() {}
+	Batch::~Batch() {}
+	void flush() {
+		std::cout << std::flush;
+	}
 
 	void cursor_reset() {
 		SetConsoleCursorPosition(handle, {0, 0});
@@ -113,21 +152,30 @@ namespace console {
 		system("cls");
 	}
 
-	void foreground_color(Color);
-	void background_color(Color);
+	Area terminal_size() {
+		CONSOLE_SCREEN_BUFFER_INFO info;
+		if(!GetConsoleScreenBufferInfo(handle, &info)) return {80, 24};
+		return {uint_type(info.srWindow.Right - info.srWindow.Left + 1), uint_type(info.srWindow.Bottom - info.srWindow.Top + 1)};
+	}
 
+	ColorMode color_mode() {
+		return ColorMode::BASIC;
+	}
+
+	void foreground_color(Color c) {
+		set_color(c, back_color);
+	}
+	void background_color(Color c) {
+		set_color(fore_color, c);
+	}
 	void foreground_color(ColorEnum c) {
-		SetConsoleTextAttribute(handle, get_foreground_color_id(c) | get_background_color_id(back_color));
-		fore_color = c;
+		set_color(c, back_color);
 	}
 	void background_color(ColorEnum c) {
-		SetConsoleTextAttribute(handle, get_foreground_color_id(fore_color) | get_background_color_id(c));
-		back_color = c;
+		set_color(fore_color, c);
 	}
 	void color(ColorEnum fore, ColorEnum back) {
-		SetConsoleTextAttribute(handle, get_foreground_color_id(fore) | get_background_color_id(back));
-		fore_color = fore;
-		back_color = back;
+		set_color(fore, back);
 	}
 	void color_reset() {
 		color(ColorEnum::WHITE, ColorEnum::BLACK);
@@ -154,4 +202,117 @@ namespace console {
 		}
 		return {};
 	}
+
+	Keyboard::Keyboard(int escape_timeout_ms) : escape_timeout(escape_timeout_ms) {}
+
+	std::optional<KeyPress> Keyboard::read(int timeout_ms) {
+		if(!fill(timeout_ms)) return {};
+		if(resized) {
+			resized = false;
+			return KeyPress(Key::RESIZE);
+		}
+		return decode(true);
+	}
+
+	bool Keyboard::fill(int timeout_ms) {
+		// The console can't be waited on together with a timeout, so it's checked every millisecond.
+		// Resizes are noticed by the size changing meanwhile.
+		constexpr DWORD RESIZE_SETTLE_MS = 50;
+		const DWORD start = GetTickCount();
+		const Area size = terminal_size();
+		while(!_kbhit()) {
+			if(terminal_size() != size) {
+				for(Area settling = terminal_size(); ; ) {
+					Sleep(RESIZE_SETTLE_MS);
+					if(terminal_size() == settling) break;
+					settling = terminal_size();
+				}
+				resized = true;
+				return true;
+			}
+			if(timeout_ms >= 0 && GetTickCount() - start >= DWORD(timeout_ms)) return false;
+			Sleep(1);
+		}
+		const int c = _getch();
+		pending += char(c);
+		if(c == 0 || c == 224) pending += char(_getch()); // Special keys come in two parts
+		return true;
+	}
+
+	std::optional<KeyPress> Keyboard::decode(bool) {
+		const unsigned char first = pending[0];
+		if(first != 0 && first != 224) {
+			pending.clear();
+			if(first == 27) return KeyPress(Key::ESCAPE);
+			return KeyPress(Key::CHARACTER, first);
+		}
+		const unsigned char second = pending[1];
+		pending.clear();
+		switch(second) {
+			case 'H': return KeyPress(Key::UP);
+			case 'P': return KeyPress(Key::DOWN);
+			case 'K': return KeyPress(Key::LEFT);
+			case 'M': return KeyPress(Key::RIGHT);
+			case 'G': return KeyPress(Key::HOME);
+			case 'O': return KeyPress(Key::END);
+			case 'R': return KeyPress(Key::INSERT);
+			case 'S': return KeyPress(Key::DEL);
+			case 'I': return KeyPress(Key::PAGE_UP);
+			case 'Q': return KeyPress(Key::PAGE_DOWN);
+			case 133: return KeyPress(Key::F11);
+			case 134: return KeyPress(Key::F12);
+		}
+		if(second >= 59 && second <= 68) return KeyPress(Key(int(Key::F1) + second - 59));
+		return KeyPress(Key::UNKNOWN);
+	}
+
+	void bracketed_paste(bool) {}
+
+	size_t Screen::present() {
+		size_t written = 0;
+		const Area current_terminal = terminal_size();
+		if(current_terminal != terminal) {
+			terminal = current_terminal;
+			invalidated = true;
+			color_reset();
+			screen_clear();
+		}
+		const Area visible = {std::min(m_size.w, terminal.w), std::min(m_size.h, terminal.h)};
+
+		for(uint_type y = 0; y < visible.h; ++y) {
+			uint_type x = 0;
+			while(x < visible.w) {
+				if(!invalidated && front[y * m_size.w + x] == back[y * m_size.w + x]) {
+					++x;
+					continue;
+				}
+				const uint_type start = run_start({x, y});
+				x = start;
+				cursor_gotoxy({x, y}); // Start of a run
+				for(; x < visible.w; ++x) {
+					const size_t index = y * m_size.w + x;
+					const Cell c = back[index];
+					if(x != start && !invalidated && front[index] == c) break;
+
+					set_color(c.fore, c.back);
+					const char32_t shown = shown_glyph({x, y}, visible.w);
+					char glyph[4];
+					int length = utf32to8(shown, glyph);
+					std::cout.write(glyph, length).flush(); // Text attributes apply to what is written afterwards.
+					written += length;
+					front[index] = c;
+					if(char_width(shown) == 2) {
+						++x;
+						front[index + 1] = back[index + 1];
+					}
+				}
+			}
+		}
+		invalidated = false;
+		if(written == 0) return 0;
+
+		color_reset();
+		cursor_gotoxy({0, std::min(m_size.h, terminal.h - 1)});
+		return written;
+	}
 }
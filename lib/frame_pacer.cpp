@@ -0,0 +1,156 @@
+#include "frame_pacer.h"
+
+#include <vector>
+#include <thread>
+#include <chrono>
+
+FramePacer::FramePacer(Mode mode_, double target_fps_) :
+	mode(mode_),
+	target_fps(target_fps_ > 0 ? target_fps_ : DEFAULT_REFRESH_RATE),
+	window(nullptr),
+	render(nullptr),
+	m_software(false),
+	m_vsync(false),
+	frequency(SDL_GetPerformanceFrequency()),
+	period(0),
+	spin_tail(static_cast<Uint64>(SPIN_TAIL_MS / 1000 * frequency)),
+	deadline(0),
+	m_present_latency(0)
+{}
+
+SDL_Renderer *FramePacer::m_create_candidate(Candidate c) {
+	if(c.software) {
+		SDL_Surface *screen = SDL_GetWindowSurface(window);
+		if(!screen) return nullptr;
+		return SDL_CreateSoftwareRenderer(screen);
+	}
+	return SDL_CreateRenderer(window, -1, c.flags);
+}
+
+Uint64 FramePacer::m_benchmark(SDL_Renderer *r, SDL_Surface *surface, SDL_Surface *window_copy) {
+	Uint64 start = 0;
+	for(uint_type i = 0; i <= BENCHMARK_FRAMES; ++i) {
+		if(i == 1) start = SDL_GetPerformanceCounter(); // The first frame warms up.
+		SDL_SetRenderDrawColor(r, 0, 0, 0, 255);
+		SDL_RenderClear(r);
+		SDL_RenderPresent(r);
+		if(window_copy) SDL_BlitSurface(surface, nullptr, window_copy, nullptr);
+	}
+	return (SDL_GetPerformanceCounter() - start) / BENCHMARK_FRAMES;
+}
+
+Uint64 FramePacer::m_benchmark_offscreen() {
+	int w, h;
+	SDL_GetWindowSize(window, &w, &h);
+	const Uint32 format = SDL_GetWindowPixelFormat(window);
+	SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, SDL_BITSPERPIXEL(format), format);
+	SDL_Surface *window_copy = SDL_CreateRGBSurfaceWithFormat(0, w, h, SDL_BITSPERPIXEL(format), format);
+	SDL_Renderer *r = surface && window_copy ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+	const Uint64 time = r ? m_benchmark(r, surface, window_copy) : UINT64_MAX;
+	if(r) SDL_DestroyRenderer(r);
+	if(window_copy) SDL_FreeSurface(window_copy);
+	if(surface) SDL_FreeSurface(surface);
+	return time;
+}
+
+SDL_Renderer *FramePacer::create_renderer(SDL_Window *window_, bool allow_hardware) {
+	window = window_;
+
+	double refresh_rate = DEFAULT_REFRESH_RATE;
+	{
+		SDL_DisplayMode display_mode;
+		int display = SDL_GetWindowDisplayIndex(window);
+		if(display >= 0 && SDL_GetCurrentDisplayMode(display, &display_mode) == 0 && display_mode.refresh_rate > 0) {
+			refresh_rate = display_mode.refresh_rate;
+		}
+	}
+	const Uint64 refresh_period = static_cast<Uint64>(frequency / refresh_rate);
+	const Uint64 target_period = static_cast<Uint64>(frequency / target_fps);
+
+	std::vector<Candidate> candidates;
+	if(allow_hardware) {
+		if(mode == Mode::VSYNC) candidates.push_back({SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC, false});
+		candidates.push_back({SDL_RENDERER_ACCELERATED, false});
+	}
+	candidates.push_back({0, true});
+
+	render = nullptr;
+	const Candidate *best = nullptr;
+	Uint64 best_time = 0;
+	bool fits = false;
+	for(const Candidate &c : candidates) {
+		if(c.software) break; // Tried last, below
+		// A window can only have one renderer, so each is destroyed once benchmarked, and the best made again.
+		SDL_Renderer *r = m_create_candidate(c);
+		if(!r) {
+			log_error("Warning: cannot create accelerated renderer: %s.", SDL_GetError());
+			continue;
+		}
+		const Uint64 time = m_benchmark(r);
+		SDL_DestroyRenderer(r);
+		const bool vsync_candidate = c.flags & SDL_RENDERER_PRESENTVSYNC;
+		// A vsync renderer is expected to take a refresh period, but no longer.
+		const Uint64 budget = vsync_candidate ? refresh_period * 3 / 2 : (mode == Mode::VSYNC ? refresh_period : target_period);
+		fits = time <= budget;
+		if(fits || !best || time < best_time) {
+			best = &c;
+			best_time = time;
+		}
+		if(fits) break;
+	}
+	// The window surface can't be used along with a renderer of the window, and once taken, no accelerated
+	// renderer can be made any more. So the software renderer is measured offscreen, at the size and format
+	// of the window and with the copy that updating the window surface costs, and the window surface is
+	// only taken if it wins.
+	const Candidate &software = candidates.back();
+	if(!fits && (!best || m_benchmark_offscreen() < best_time)) best = &software;
+	if(!best->software) {
+		render = m_create_candidate(*best);
+		if(!render) {
+			log_error("Warning: cannot create accelerated renderer: %s.", SDL_GetError());
+			best = &software;
+		}
+	}
+	if(best->software) {
+		render = m_create_candidate(software);
+		if(!render) {
+			log_error("Warning: cannot create software renderer: %s.", SDL_GetError());
+			return nullptr;
+		}
+	}
+
+	m_software = best->software;
+	m_vsync = best->flags & SDL_RENDERER_PRESENTVSYNC;
+	period = mode == Mode::VSYNC ? refresh_period : target_period;
+	deadline = 0;
+	return render;
+}
+
+void FramePacer::present() {
+	const Uint64 start = SDL_GetPerformanceCounter();
+	if(m_software) {
+		SDL_UpdateWindowSurface(window);
+	} else {
+		SDL_RenderPresent(render);
+	}
+	const double latency = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+	m_present_latency = m_present_latency == 0 ? latency : m_present_latency * 0.9 + latency * 0.1;
+}
+
+void FramePacer::wait() {
+	Uint64 now = SDL_GetPerformanceCounter();
+	if(m_vsync) {
+		deadline = now;
+		return;
+	}
+	if(deadline == 0 || now > deadline + period) { // Late for more than a frame.
+		deadline = now;
+	}
+	deadline += period;
+	if(deadline > now + spin_tail) {
+		std::this_thread::sleep_for(std::chrono::microseconds((deadline - now - spin_tail) * 1000000 / frequency));
+	}
+	while(SDL_GetPerformanceCounter() < deadline) {
+		std::this_thread::yield();
+	}
+}
@@ -0,0 +1,103 @@
+#ifndef __FRAME_PACER_H__
+#define __FRAME_PACER_H__
+
+#include <cstdint>
+#include <SDL2/SDL.h>
+#include <utils.h>
+
+/*
+ * Paces the frames of an SDL program, either by vsync or by a target frame rate,
+ * and picks the renderer a program draws with.
+ *
+ * Usage:
+ * 	FramePacer pacer(FramePacer::Mode::VSYNC);
+ * 	SDL_Renderer *render = pacer.create_renderer(window);
+ * 	while(...) {
+ * 		... // Draw
+ * 		pacer.present();
+ * 		pacer.wait();
+ * 	}
+ */
+class FramePacer {
+public:
+	enum class Mode : uint8_t {
+		VSYNC, // Synchronize with the display, or run at its refresh rate if vsync is unavailable.
+		TARGET_FPS
+	};
+	constexpr static double DEFAULT_REFRESH_RATE = 60;
+	constexpr static uint_type BENCHMARK_FRAMES = 6;
+	constexpr static double SPIN_TAIL_MS = 1; // Spin instead of sleeping for the last part of a frame.
+
+	FramePacer(Mode mode, double target_fps = DEFAULT_REFRESH_RATE);
+	FramePacer(const FramePacer &) = delete;
+	FramePacer &operator=(const FramePacer &) = delete;
+
+	/*
+	 * Create a renderer for the window, which should have been shown, for vsync can't be observed on a hidden window.
+	 * Candidates are tried in order of preference: accelerated with vsync(in Mode::VSYNC only),
+	 * accelerated, software. Each is benchmarked for BENCHMARK_FRAMES frames and the first one
+	 * that keeps up with the frame period is chosen; if none does, the fastest one is chosen.
+	 * A window has one renderer at a time, so each is destroyed once benchmarked and the one chosen made again.
+	 * The software renderer draws on the window surface, which can't be shared with another renderer, so it's
+	 * benchmarked offscreen and the window surface is only taken once it's chosen.
+	 * It's the only candidate if allow_hardware is false.
+	 *
+	 * The renderer returned needs destroyed by SDL_DestroyRenderer manually.
+	 * Return nullptr if no renderer can be created.
+	 */
+	SDL_Renderer *create_renderer(SDL_Window *window, bool allow_hardware = true);
+
+	bool software() const {return m_software;}
+	bool vsync() const {return m_vsync;}
+
+	/*
+	 * Present the frame drawn with the renderer created, and measure how long it takes.
+	 */
+	void present();
+	/*
+	 * Sleep until the next frame should start. Return immediately if presenting is synchronized by vsync.
+	 * A frame that is late pushes back the following deadlines instead of being caught up with.
+	 */
+	void wait();
+
+	/*
+	 * Time presenting takes in milliseconds, smoothed over the last frames.
+	 */
+	double present_latency() const {return m_present_latency;}
+	/*
+	 * Time between two frames in milliseconds when paced by wait().
+	 */
+	double frame_period() const {return period * 1000.0 / frequency;}
+private:
+	struct Candidate {
+		Uint32 flags;
+		bool software;
+	};
+
+	SDL_Renderer *m_create_candidate(Candidate c);
+	/*
+	 * Return the average time of a frame in performance counter ticks.
+	 * If window_copy is given, surface, which render draws on, is copied to it every frame.
+	 */
+	Uint64 m_benchmark(SDL_Renderer *render, SDL_Surface *surface = nullptr, SDL_Surface *window_copy = nullptr);
+	/*
+	 * The same for a software renderer on a surface of the size and format of the window, without touching it,
+	 * each frame copied to another such surface as SDL_UpdateWindowSurface() copies it to the window.
+	 * Return UINT64_MAX if it can't be made.
+	 */
+	Uint64 m_benchmark_offscreen();
+
+	Mode mode;
+	double target_fps;
+
+	SDL_Window *window;
+	SDL_Renderer *render;
+	bool m_software, m_vsync;
+
+	Uint64 frequency;
+	Uint64 period, spin_tail; // In ticks of performance counter.
+	Uint64 deadline; // When the next frame should start, 0 if not started yet.
+	double m_present_latency;
+};
+
+#endif
@@ -7,19 +7,41 @@
 #include <cstring>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <array>
+#include <bit>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <poll.h>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include <packed_font.h>
 
 using std::string_view;
 using std::unique_ptr;
 using std::swap;
 
+static const PixelFunctions *pixel_functions_for(const fb_var_screeninfo &vinfo);
+static void delete_tiled(TiledRenderer *tiled);
+
 #define RELEASE_RESOURCE \
+	delete_tiled(tiled); \
+	if(if_flipping) end_flipping(); \
 	if(data) munmap(data, smem_len); \
 	if(fbfd) close(fbfd); \
-	delete[] buffer;
+	if(!if_flipping) delete[] buffer;
 
 Framebuffer::Framebuffer(string_view device_name_view, bool nobuffer) : Framebuffer() {
 	{
@@ -43,6 +65,14 @@ Framebuffer::Framebuffer(string_view device_name_view, bool nobuffer) : Framebuf
 			close(fbfd);
 			throw FramebufferError(strerror(errno));
 		}
+		pixel_functions = pixel_functions_for(vinfo);
+		if(!pixel_functions) {
+			close(fbfd);
+			throw FramebufferError("Unsupported pixel format");
+		}
+		if(!nobuffer) if_flipping = start_flipping(vinfo, finfo);
+		if_vsync = true; // Until FBIO_WAITFORVSYNC fails
+		var_info = vinfo;
 		smem_len = finfo.smem_len;
 		line_length = finfo.line_length;
 		fbsize = {vinfo.xres, vinfo.yres};
@@ -50,16 +80,76 @@ Framebuffer::Framebuffer(string_view device_name_view, bool nobuffer) : Framebuf
 	}
 	data = (uint8_t *)mmap(0, smem_len, PROT_READ | PROT_WRITE, MAP_SHARED, fbfd, 0);
 	if(data == MAP_FAILED) {
+		const int error = errno;
+		data = nullptr;
+		if(if_flipping) end_flipping();
 		close(fbfd);
 		fbfd = 0;
-		data = nullptr;
+		throw FramebufferError(strerror(error));
+	}
+
+	set_up_buffer(nobuffer);
+}
+Framebuffer Framebuffer::offscreen(Area size, string_view file_name, bool nobuffer) {
+	if(size.w == 0 || size.h == 0) {
+		throw FramebufferError("Empty size");
+	}
+	if(size.w > UINT32_MAX / 4 / size.h) {
+		throw FramebufferError("Size too large");
+	}
+	Framebuffer fb;
+	fb_var_screeninfo vinfo{};
+	vinfo.xres = vinfo.xres_virtual = size.w;
+	vinfo.yres = vinfo.yres_virtual = size.h;
+	vinfo.bits_per_pixel = 32;
+	vinfo.red = {16, 8, 0};
+	vinfo.green = {8, 8, 0};
+	vinfo.blue = {0, 8, 0};
+	vinfo.transp = {24, 8, 0};
+	fb.pixel_functions = pixel_functions_for(vinfo);
+	fb.var_info = vinfo;
+	fb.line_length = size.w * 4;
+	fb.smem_len = fb.line_length * size.h;
+	fb.fbsize = size;
+	fb.bytes_per_pixel = 4;
+
+	if(file_name.empty()) {
+		fb.data = (uint8_t *)mmap(0, fb.smem_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	} else {
+		// From here on, the destructor of fb releases what was acquired if something fails
+		fb.fbfd = open(std::string(file_name).c_str(), O_RDWR | O_CREAT, 0644);
+		if(fb.fbfd < 0) {
+			fb.fbfd = 0;
+			throw FramebufferError(strerror(errno));
+		}
+		if(ftruncate(fb.fbfd, fb.smem_len) < 0) {
+			throw FramebufferError(strerror(errno));
+		}
+		fb.data = (uint8_t *)mmap(0, fb.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED, fb.fbfd, 0);
+	}
+	if(fb.data == MAP_FAILED) {
+		fb.data = nullptr;
 		throw FramebufferError(strerror(errno));
 	}
 
-	if(!nobuffer) buffer = new uint8_t[smem_len];
+	fb.set_up_buffer(nobuffer);
+	return fb;
+}
+/*
+ * Choose where drawing goes once data is mapped, and load the buffer from it.
+ */
+void Framebuffer::set_up_buffer(bool nobuffer) {
+	front = data;
+	if(if_flipping) {
+		buffer = data + fbsize.h * line_length;
+	} else if(!nobuffer) {
+		buffer = new uint8_t[smem_len];
+	}
 	if_nobuffer = nobuffer;
 	m_valid = true;
 
+	if(!nobuffer) dirty.resize(fbsize.h);
+	invalidate();
 	reset_buffer();
 }
 Framebuffer::~Framebuffer() {
@@ -70,18 +160,29 @@ Framebuffer::Framebuffer(Framebuffer &&f) :
 	if_blend(f.if_blend),
 	if_nobuffer(f.if_nobuffer),
 	m_valid(f.m_valid),
+	if_flipping(f.if_flipping),
+	if_vsync(f.if_vsync),
 	fbfd(f.fbfd),
 	data(f.data),
 	buffer(f.buffer),
+	front(f.front),
+	var_info(f.var_info),
+	original_yres_virtual(f.original_yres_virtual),
 	fbsize(f.fbsize),
 	smem_len(f.smem_len),
 	bytes_per_pixel(f.bytes_per_pixel),
-	line_length(f.line_length)
+	line_length(f.line_length),
+	pixel_functions(f.pixel_functions),
+	tiled(f.tiled),
+	dirty(std::move(f.dirty))
 {
 	f.fbfd = 0;
 	f.data = nullptr;
 	f.buffer = nullptr;
+	f.front = nullptr;
 	f.m_valid = false;
+	f.if_flipping = false;
+	f.tiled = nullptr;
 }
 Framebuffer &Framebuffer::operator=(Framebuffer &&f) & {
 	RELEASE_RESOURCE
@@ -89,68 +190,716 @@ Framebuffer &Framebuffer::operator=(Framebuffer &&f) & {
 		if_blend = f.if_blend;
 		if_nobuffer = f.if_nobuffer;
 		m_valid = f.m_valid;
+		if_flipping = f.if_flipping;
+		if_vsync = f.if_vsync;
 		fbfd = f.fbfd;
 		data = f.data;
 		buffer = f.buffer;
+		front = f.front;
+		var_info = f.var_info;
+		original_yres_virtual = f.original_yres_virtual;
 		fbsize = f.fbsize;
 		smem_len = f.smem_len;
 		bytes_per_pixel = f.bytes_per_pixel;
 		line_length = f.line_length;
+		pixel_functions = f.pixel_functions;
+		tiled = f.tiled;
+		dirty = std::move(f.dirty);
 
 		f.fbfd = 0;
 		f.data = nullptr;
 		f.buffer = nullptr;
+		f.front = nullptr;
 		f.m_valid = false;
+		f.if_flipping = false;
+		f.tiled = nullptr;
 	} else {
 		fbfd = 0;
 		data = nullptr;
 		buffer = nullptr;
+		front = nullptr;
 		m_valid = false;
+		if_flipping = false;
+		tiled = nullptr;
+		dirty.clear();
 	}
 	return *this;
 }
 
+/*
+ * The value of a pixel in the 32-bit layout of the framebuffer.
+ */
+static uint32_t pixel_value(Color c) {
+	return (c.a << 24) + (c.r << 16) + (c.g << 8) + c.b;
+}
+static Color pixel_color(uint32_t value) {
+	return {uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value), uint8_t(value >> 24)};
+}
+
+/*
+ * Set count pixels of 32 bits starting at dest to value.
+ * Fills larger than the cache bypass it with non-temporal stores, since they would only evict everything else.
+ */
+static void fill_pixels(uint32_t *dest, size_t count, uint32_t value) {
+#ifdef __SSE2__
+	constexpr size_t STREAM_THRESHOLD = 1 << 18; // 1 MB of pixels
+	for(; count > 0 && reinterpret_cast<uintptr_t>(dest) % 16 != 0; --count) *dest++ = value;
+
+	const __m128i v = _mm_set1_epi32(value);
+	__m128i *blocks = reinterpret_cast<__m128i *>(dest), *blocks_end = blocks + count / 4;
+	if(count >= STREAM_THRESHOLD) {
+		for(; blocks != blocks_end; ++blocks) _mm_stream_si128(blocks, v);
+		_mm_sfence(); // Streaming stores are weakly ordered
+	} else {
+		for(; blocks != blocks_end; ++blocks) _mm_store_si128(blocks, v);
+	}
+	dest = reinterpret_cast<uint32_t *>(blocks);
+	count %= 4;
+#endif
+	std::fill_n(dest, count, value);
+}
+
+/*
+ * Draw src over dest by the alpha of src, in 8-bit fixed point. The result is opaque,
+ * unless src is fully transparent and dest is left as it is.
+ * x / 255 is computed as (x + 128 + ((x + 128) >> 8)) >> 8, which is exact for x <= 255 * 255.
+ */
+static uint32_t blend_pixel(uint32_t dest, uint32_t src) {
+	const uint32_t a = src >> 24, na = 255 - a;
+	if(a == 0) return dest;
+	uint32_t result = 0xff000000;
+	for(int shift = 0; shift < 24; shift += 8) {
+		uint32_t t = ((src >> shift) & 0xff) * a + ((dest >> shift) & 0xff) * na + 128;
+		result |= ((t + (t >> 8)) >> 8) << shift;
+	}
+	return result;
+}
+
+/*
+ * The blend kernels draw count pixels of src over dest, as blend_pixel() does.
+ * If CONSTANT, src points to a single pixel drawn over all of them.
+ */
+using BlendKernel = void (*)(uint32_t *dest, const uint32_t *src, size_t count);
+
+template<bool CONSTANT>
+static void blend_scalar(uint32_t *dest, const uint32_t *src, size_t count) {
+	for(size_t i = 0; i < count; ++i) dest[i] = blend_pixel(dest[i], src[CONSTANT ? 0 : i]);
+}
+
+#ifdef __SSE2__
+/*
+ * Two pixels per register, a channel per 16-bit lane, so that products of two channels fit.
+ */
+static inline __m128i blend_half_sse2(__m128i dest, __m128i src) {
+	const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, 0xff), 0xff);
+	const __m128i inverse_alpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(src, alpha), _mm_mullo_epi16(dest, inverse_alpha));
+	t = _mm_add_epi16(t, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+template<bool CONSTANT>
+static void blend_sse2(uint32_t *dest, const uint32_t *src, size_t count) {
+	const __m128i zero = _mm_setzero_si128(), alpha_mask = _mm_set1_epi32(0xff000000);
+	size_t i = 0;
+	for(; i + 4 <= count; i += 4) {
+		const __m128i s = CONSTANT ? _mm_set1_epi32(*src) : _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		const __m128i alpha = _mm_and_si128(s, alpha_mask), transparent = _mm_cmpeq_epi32(alpha, zero);
+		if(_mm_movemask_epi8(transparent) == 0xffff) continue;
+		__m128i *d = reinterpret_cast<__m128i *>(dest + i);
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alpha_mask)) == 0xffff) {
+			_mm_storeu_si128(d, s);
+			continue;
+		}
+		const __m128i dv = _mm_loadu_si128(d);
+		const __m128i low = blend_half_sse2(_mm_unpacklo_epi8(dv, zero), _mm_unpacklo_epi8(s, zero));
+		const __m128i high = blend_half_sse2(_mm_unpackhi_epi8(dv, zero), _mm_unpackhi_epi8(s, zero));
+		const __m128i result = _mm_or_si128(_mm_packus_epi16(low, high), alpha_mask);
+		_mm_storeu_si128(d, _mm_or_si128(_mm_and_si128(transparent, dv), _mm_andnot_si128(transparent, result)));
+	}
+	blend_scalar<CONSTANT>(dest + i, CONSTANT ? src : src + i, count - i);
+}
+#endif
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#define BLEND_AVX2
+/*
+ * The same as blend_sse2 with 8 pixels at a time, built for AVX2 even when the rest isn't
+ * and only called when the CPU supports it.
+ */
+__attribute__((target("avx2")))
+static inline __m256i blend_half_avx2(__m256i dest, __m256i src) {
+	const __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src, 0xff), 0xff);
+	const __m256i inverse_alpha = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+	__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(src, alpha), _mm256_mullo_epi16(dest, inverse_alpha));
+	t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+template<bool CONSTANT>
+__attribute__((target("avx2")))
+static void blend_avx2(uint32_t *dest, const uint32_t *src, size_t count) {
+	const __m256i zero = _mm256_setzero_si256(), alpha_mask = _mm256_set1_epi32(0xff000000);
+	size_t i = 0;
+	for(; i + 8 <= count; i += 8) {
+		const __m256i s = CONSTANT ? _mm256_set1_epi32(*src) : _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+		const __m256i alpha = _mm256_and_si256(s, alpha_mask), transparent = _mm256_cmpeq_epi32(alpha, zero);
+		if(_mm256_movemask_epi8(transparent) == -1) continue;
+		__m256i *d = reinterpret_cast<__m256i *>(dest + i);
+		if(_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alpha_mask)) == -1) {
+			_mm256_storeu_si256(d, s);
+			continue;
+		}
+		// Unpacking and packing work within 128-bit lanes, so the pixels come back in order
+		const __m256i dv = _mm256_loadu_si256(d);
+		const __m256i low = blend_half_avx2(_mm256_unpacklo_epi8(dv, zero), _mm256_unpacklo_epi8(s, zero));
+		const __m256i high = blend_half_avx2(_mm256_unpackhi_epi8(dv, zero), _mm256_unpackhi_epi8(s, zero));
+		const __m256i result = _mm256_or_si256(_mm256_packus_epi16(low, high), alpha_mask);
+		_mm256_storeu_si256(d, _mm256_blendv_epi8(result, dv, transparent));
+	}
+	blend_sse2<CONSTANT>(dest + i, CONSTANT ? src : src + i, count - i);
+}
+#endif
+
+/*
+ * The fastest kernel the CPU supports, chosen at the first call.
+ */
+template<bool CONSTANT>
+static BlendKernel blend_kernel() {
+	static const BlendKernel kernel = [] () -> BlendKernel {
+#ifdef BLEND_AVX2
+		if(__builtin_cpu_supports("avx2")) return blend_avx2<CONSTANT>;
+#endif
+#ifdef __SSE2__
+		return blend_sse2<CONSTANT>;
+#else
+		return blend_scalar<CONSTANT>;
+#endif
+	}();
+	return kernel;
+}
+
+/*
+ * Where the channels are in a pixel of the framebuffer, as fb_var_screeninfo describes them.
+ * Pixels are converted from and to the 32-bit layout of Image. A format without alpha reads as opaque.
+ * Pixels are in the byte order of the CPU, as fbdev has them.
+ */
+template<unsigned BYTES, unsigned R_OFFSET, unsigned R_LENGTH, unsigned G_OFFSET, unsigned G_LENGTH,
+	unsigned B_OFFSET, unsigned B_LENGTH, unsigned A_OFFSET, unsigned A_LENGTH>
+struct PixelFormat {
+	static constexpr unsigned bytes = BYTES;
+
+	/*
+	 * Alpha isn't compared, since drivers often report none for the padding byte.
+	 */
+	static bool matches(const fb_var_screeninfo &vinfo) {
+		return vinfo.bits_per_pixel == BYTES * 8 &&
+			vinfo.red.offset == R_OFFSET && vinfo.red.length == R_LENGTH &&
+			vinfo.green.offset == G_OFFSET && vinfo.green.length == G_LENGTH &&
+			vinfo.blue.offset == B_OFFSET && vinfo.blue.length == B_LENGTH;
+	}
+
+	template<unsigned OFFSET, unsigned LENGTH>
+	static uint32_t narrow(uint32_t channel) {
+		return ((channel & 0xff) >> (8 - LENGTH)) << OFFSET;
+	}
+	static uint32_t pack(uint32_t value) {
+		return narrow<R_OFFSET, R_LENGTH>(value >> 16) | narrow<G_OFFSET, G_LENGTH>(value >> 8) |
+			narrow<B_OFFSET, B_LENGTH>(value) | narrow<A_OFFSET, A_LENGTH>(value >> 24);
+	}
+
+	// The high bits are repeated in the low ones, so that the maximum stays 255
+	template<unsigned OFFSET, unsigned LENGTH, uint32_t ABSENT = 0>
+	static uint32_t widen(uint32_t pixel) {
+		if constexpr(LENGTH == 0) {
+			return ABSENT;
+		} else {
+			const uint32_t channel = (pixel >> OFFSET) & ((1u << LENGTH) - 1);
+			return (channel << (8 - LENGTH)) | (channel >> (2 * LENGTH - 8));
+		}
+	}
+	static uint32_t unpack(uint32_t pixel) {
+		return widen<A_OFFSET, A_LENGTH, 0xff>(pixel) << 24 | widen<R_OFFSET, R_LENGTH>(pixel) << 16 |
+			widen<G_OFFSET, G_LENGTH>(pixel) << 8 | widen<B_OFFSET, B_LENGTH>(pixel);
+	}
+
+	static uint32_t load(const uint8_t *pixel) {
+		uint32_t value = 0;
+		memcpy(&value, pixel, BYTES);
+		return value;
+	}
+	static void store(uint8_t *pixel, uint32_t value) {
+		memcpy(pixel, &value, BYTES);
+	}
+};
+using RGB565 = PixelFormat<2, 11, 5, 5, 6, 0, 5, 0, 0>;
+using RGB888 = PixelFormat<3, 16, 8, 8, 8, 0, 8, 0, 0>;
+using XRGB8888 = PixelFormat<4, 16, 8, 8, 8, 0, 8, 24, 8>; // The layout of Image. Alpha is kept in the padding byte.
+using BGRA8888 = PixelFormat<4, 8, 8, 16, 8, 24, 8, 0, 8>;
+
+/*
+ * What the drawing primitives need from a pixel format, a row at a time.
+ * Values and sources are in the layout of Image.
+ */
+struct PixelFunctions {
+	uint32_t (*get)(const uint8_t *pixel);
+	void (*set)(uint8_t *pixel, uint32_t value);
+	void (*blend_set)(uint8_t *pixel, uint32_t value);
+	void (*fill)(uint8_t *row, size_t count, uint32_t value);
+	void (*blend_fill)(uint8_t *row, size_t count, uint32_t value);
+	void (*copy)(uint8_t *row, const uint32_t *source, size_t count);
+	void (*blend)(uint8_t *row, const uint32_t *source, size_t count);
+};
+
+template<typename Format>
+struct PixelRows {
+	static constexpr bool NATIVE = std::is_same_v<Format, XRGB8888>;
+
+	static uint32_t get(const uint8_t *pixel) {
+		return Format::unpack(Format::load(pixel));
+	}
+	static void set(uint8_t *pixel, uint32_t value) {
+		Format::store(pixel, Format::pack(value));
+	}
+	static void blend_set(uint8_t *pixel, uint32_t value) {
+		set(pixel, blend_pixel(get(pixel), value));
+	}
+	static void fill(uint8_t *row, size_t count, uint32_t value) {
+		if constexpr(Format::bytes == 4) {
+			fill_pixels(reinterpret_cast<uint32_t *>(row), count, Format::pack(value));
+		} else if constexpr(Format::bytes == 2) {
+			std::fill_n(reinterpret_cast<uint16_t *>(row), count, uint16_t(Format::pack(value)));
+		} else {
+			const uint32_t pixel = Format::pack(value);
+			for(size_t i = 0; i < count; ++i) Format::store(row + i * Format::bytes, pixel);
+		}
+	}
+	/*
+	 * Other formats are converted to the layout of Image a chunk at a time, to blend them with the same kernels.
+	 */
+	template<bool CONSTANT>
+	static void blend_converted(uint8_t *row, const uint32_t *source, size_t count) {
+		constexpr size_t CHUNK = 256;
+		uint32_t chunk[CHUNK];
+		for(size_t done = 0; done < count; done += CHUNK, row += CHUNK * Format::bytes) {
+			const size_t n = std::min(CHUNK, count - done);
+			for(size_t i = 0; i < n; ++i) chunk[i] = get(row + i * Format::bytes);
+			blend_kernel<CONSTANT>()(chunk, CONSTANT ? source : source + done, n);
+			for(size_t i = 0; i < n; ++i) set(row + i * Format::bytes, chunk[i]);
+		}
+	}
+	static void blend_fill(uint8_t *row, size_t count, uint32_t value) {
+		if constexpr(NATIVE) {
+			blend_kernel<true>()(reinterpret_cast<uint32_t *>(row), &value, count);
+		} else {
+			blend_converted<true>(row, &value, count);
+		}
+	}
+	static void copy(uint8_t *row, const uint32_t *source, size_t count) {
+		if constexpr(NATIVE) {
+			memcpy(row, source, count * sizeof(uint32_t));
+		} else {
+			for(size_t i = 0; i < count; ++i, row += Format::bytes) set(row, source[i]);
+		}
+	}
+	static void blend(uint8_t *row, const uint32_t *source, size_t count) {
+		if constexpr(NATIVE) {
+			blend_kernel<false>()(reinterpret_cast<uint32_t *>(row), source, count);
+		} else {
+			blend_converted<false>(row, source, count);
+		}
+	}
+};
+
+template<typename Format>
+constexpr PixelFunctions PIXEL_FUNCTIONS = {
+	PixelRows<Format>::get, PixelRows<Format>::set, PixelRows<Format>::blend_set, PixelRows<Format>::fill,
+	PixelRows<Format>::blend_fill, PixelRows<Format>::copy, PixelRows<Format>::blend,
+};
+
+/*
+ * The functions for the format of the device, or nullptr if it's none of the known ones.
+ */
+static const PixelFunctions *pixel_functions_for(const fb_var_screeninfo &vinfo) {
+	if(XRGB8888::matches(vinfo)) return &PIXEL_FUNCTIONS<XRGB8888>;
+	if(BGRA8888::matches(vinfo)) return &PIXEL_FUNCTIONS<BGRA8888>;
+	if(RGB888::matches(vinfo)) return &PIXEL_FUNCTIONS<RGB888>;
+	if(RGB565::matches(vinfo)) return &PIXEL_FUNCTIONS<RGB565>;
+	return nullptr;
+}
+
+Image::Image(Area size, Color c) : size(size), pixels(size.w * size.h, pixel_value(c)) {}
+
+Color Image::get(UCoord pos) const {
+	assert(pos.x < size.w && pos.y < size.h);
+	return pixel_color(pixels[pos.y * size.w + pos.x]);
+}
+
+void Image::set(UCoord pos, Color c) {
+	assert(pos.x < size.w && pos.y < size.h);
+	pixels[pos.y * size.w + pos.x] = pixel_value(c);
+}
+
+/*
+ * Scales an image to another size a row at a time, for the visible columns [first_column, first_column + columns).
+ * The center of each pixel is mapped to the source, where pixel x spans from x to x + 1: destination x falls
+ * at (x + 0.5) * source width / width, in 16.16 fixed point. Bilinear weights are cut to 8 bits, so that
+ * the red and blue channels of a pixel, then its alpha and green, are interpolated together in one integer.
+ * The source rows of a bilinear row are scaled across first and kept, since the following rows mostly
+ * need the same ones when stretching.
+ */
+class ImageScaler {
+public:
+	ImageScaler(const Image &image, Area size, ScaleFilter filter, uint_type first_column, uint_type columns);
+	/*
+	 * Scale the rows [first, last) and pass each one to f with its y, as f(y, pixels).
+	 * Rows may be scaled on several threads at once, each with its own range.
+	 */
+	template<typename Function>
+	void scale_rows(uint_type first, uint_type last, Function f) const;
+private:
+	/*
+	 * Where a destination pixel falls on one axis: between source pixels index and next, weight / 256 of the way.
+	 */
+	struct Sample {
+		uint32_t index, next;
+		uint32_t weight;
+	};
+	static Sample sample(uint_type source_length, uint_type length, uint_type position, bool bilinear);
+	void scale_across(const uint32_t *source, uint32_t *row) const;
+
+	const Image &image;
+	bool bilinear;
+	Area size;
+	std::vector<Sample> column_samples;
+};
+
+ImageScaler::ImageScaler(const Image &image_, Area size_, ScaleFilter filter, uint_type first_column, uint_type columns) :
+	image(image_), bilinear(filter == ScaleFilter::BILINEAR), size(size_), column_samples(columns) {
+	for(uint_type x = 0; x < columns; ++x) column_samples[x] = sample(image.size.w, size.w, first_column + x, bilinear);
+}
+
+ImageScaler::Sample ImageScaler::sample(uint_type source_length, uint_type length, uint_type position, bool bilinear) {
+	const uint64_t center = ((2 * uint64_t(position) + 1) * source_length << 16) / (2 * length);
+	if(!bilinear) {
+		const uint32_t index = center >> 16;
+		return {index, index, 0};
+	}
+	// Between the centers of the source pixels on both sides, and held at the edges
+	if(center < 0x8000) return {0, 0, 0};
+	const uint64_t between = center - 0x8000;
+	const uint32_t index = between >> 16;
+	if(index + 1 >= source_length) return {uint32_t(source_length - 1), uint32_t(source_length - 1), 0};
+	return {index, index + 1, uint32_t(between >> 8 & 0xff)};
+}
+
+static inline uint32_t lerp_pixel(uint32_t a, uint32_t b, uint32_t weight) {
+	const uint32_t rb = ((a & 0xff00ff) * (256 - weight) + (b & 0xff00ff) * weight) >> 8 & 0xff00ff;
+	const uint32_t ag = ((a >> 8 & 0xff00ff) * (256 - weight) + (b >> 8 & 0xff00ff) * weight) & 0xff00ff00;
+	return rb | ag;
+}
+
+/*
+ * Interpolate between two rows by the same weight, 16 channels at a time where SSE2 is there.
+ */
+static void lerp_rows(const uint32_t *a, const uint32_t *b, uint32_t *out, size_t count, uint32_t weight) {
+	size_t x = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i weight_a = _mm_set1_epi16(int16_t(256 - weight)), weight_b = _mm_set1_epi16(int16_t(weight));
+	for(; x + 4 <= count; x += 4) {
+		const __m128i pa = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + x));
+		const __m128i pb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + x));
+		// a * (256 - weight) + b * weight fits in 16 bits
+		const __m128i low = _mm_srli_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpacklo_epi8(pa, zero), weight_a), _mm_mullo_epi16(_mm_unpacklo_epi8(pb, zero), weight_b)), 8);
+		const __m128i high = _mm_srli_epi16(_mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpackhi_epi8(pa, zero), weight_a), _mm_mullo_epi16(_mm_unpackhi_epi8(pb, zero), weight_b)), 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(low, high));
+	}
+#endif
+	for(; x < count; ++x) out[x] = lerp_pixel(a[x], b[x], weight);
+}
+
+void ImageScaler::scale_across(const uint32_t *source, uint32_t *row) const {
+	if(!bilinear) {
+		for(size_t x = 0; x < column_samples.size(); ++x) row[x] = source[column_samples[x].index];
+		return;
+	}
+	for(size_t x = 0; x < column_samples.size(); ++x) {
+		const Sample s = column_samples[x];
+		row[x] = lerp_pixel(source[s.index], source[s.next], s.weight);
+	}
+}
+
+template<typename Function>
+void ImageScaler::scale_rows(uint_type first, uint_type last, Function f) const {
+	const size_t columns = column_samples.size();
+	std::vector<uint32_t> scratch(3 * columns);
+	uint32_t *const row = scratch.data();
+	uint32_t *upper = row + columns, *lower = upper + columns; // The last two source rows scaled across
+	uint32_t upper_index = UINT32_MAX, lower_index = UINT32_MAX;
+	const auto source_row = [this](uint32_t index) {return image.pixels.data() + index * image.size.w;};
+	for(uint_type y = first; y < last; ++y) {
+		const Sample s = sample(image.size.h, size.h, y, bilinear);
+		if(s.weight == 0) {
+			if(s.index == upper_index) {
+				f(y, upper);
+			} else if(s.index == lower_index) {
+				f(y, lower);
+			} else {
+				scale_across(source_row(s.index), row);
+				f(y, row);
+			}
+			continue;
+		}
+		if(s.index != upper_index) {
+			if(s.index == lower_index) {
+				std::swap(upper, lower);
+				std::swap(upper_index, lower_index);
+			} else {
+				scale_across(source_row(s.index), upper);
+				upper_index = s.index;
+			}
+		}
+		if(s.next != lower_index) {
+			scale_across(source_row(s.next), lower);
+			lower_index = s.next;
+		}
+		lerp_rows(upper, lower, row, columns, s.weight);
+		f(y, row);
+	}
+}
+
+/*
+ * Fewer pixels than this aren't worth a thread of their own.
+ */
+constexpr size_t MIN_PIXELS_PER_THREAD = 1 << 16;
+
+/*
+ * Call f(first, last) over [0, rows) cut into contiguous ranges, one per thread,
+ * with as many threads as there are cores and enough pixels, the calling one included.
+ */
+template<typename Function>
+static void parallel_rows(uint_type rows, uint_type width, Function f) {
+	const size_t threads = std::clamp<size_t>(rows * width / MIN_PIXELS_PER_THREAD, 1,
+		std::min<size_t>(rows, std::max(1u, std::thread::hardware_concurrency())));
+	std::vector<std::thread> workers;
+	for(size_t i = 1; i < threads; ++i) workers.emplace_back(f, rows * i / threads, rows * (i + 1) / threads);
+	f(0, rows / threads);
+	for(std::thread &worker : workers) worker.join();
+}
+
+Image Image::scaled(Area new_size, ScaleFilter filter) const {
+	Image result;
+	result.size = new_size;
+	result.pixels.resize(new_size.w * new_size.h);
+	if(new_size.w == 0 || new_size.h == 0 || size.w == 0 || size.h == 0) return result;
+	const ImageScaler scaler(*this, new_size, filter, 0, new_size.w);
+	parallel_rows(new_size.h, new_size.w, [&scaler, &result](uint_type first, uint_type last) {
+		scaler.scale_rows(first, last, [&result](uint_type y, const uint32_t *row) {
+			memcpy(&result.pixels[y * result.size.w], row, result.size.w * sizeof(uint32_t));
+		});
+	});
+	return result;
+}
+
+/*
+ * How far ahead rows are prefetched when going down the screen.
+ */
+constexpr size_t PREFETCH_ROWS = 8;
+
+/*
+ * Fill a.h rows of a.w pixels from row down, each line_length after the one above.
+ */
+static void fill_rows(const PixelFunctions &functions, uint8_t *row, size_t line_length, Area a, uint32_t value, bool blend) {
+	if(blend) {
+		for(uint_type y = 0; y < a.h; ++y, row += line_length) functions.blend_fill(row, a.w, value);
+		return;
+	}
+	for(uint_type y = 0; y < a.h; ++y, row += line_length) {
+		__builtin_prefetch(row + PREFETCH_ROWS * line_length, 1);
+		functions.fill(row, a.w, value);
+	}
+}
+
+/*
+ * Draw a.h rows of a.w pixels from source, whose rows are source_width long, like fill_rows().
+ */
+static void blit_rows(const PixelFunctions &functions, uint8_t *row, size_t line_length,
+	const uint32_t *source, size_t source_width, Area a, bool blend) {
+	const auto draw_row = blend ? functions.blend : functions.copy;
+	for(uint_type y = 0; y < a.h; ++y, row += line_length, source += source_width) draw_row(row, source, a.w);
+}
+
+/*
+ * Fills and blits recorded by a Framebuffer in tiled mode, binned into tiles of the screen.
+ * Tiles are bands of whole rows, since hardware prefetchers stop at the end of each piece of a row,
+ * which costs more than what smaller tiles save in cache.
+ * render() draws the tiles on the calling thread and the workers, which wait in between.
+ * A tile is drawn by one thread, with the commands over it in the order they were recorded,
+ * so every pixel goes through the same steps as when drawn right away.
+ */
+class TiledRenderer {
+public:
+	/*
+	 * Clipped to the screen, as Framebuffer would draw it.
+	 */
+	struct Command {
+		UCoord pos;
+		Area area;
+		const uint32_t *source; // The top left pixel of a blit at pos, or nullptr for a fill
+		uint_type source_width;
+		uint32_t value; // Of a fill
+		bool blend;
+	};
+	/*
+	 * The pixels drawn on, which may move with the Framebuffer between renders.
+	 */
+	struct Target {
+		uint8_t *pixels;
+		size_t line_length;
+		size_t bytes_per_pixel;
+		const PixelFunctions *functions;
+	};
+
+	TiledRenderer(Area screen, unsigned threads);
+	TiledRenderer(const TiledRenderer &) = delete;
+	~TiledRenderer();
+	TiledRenderer &operator=(const TiledRenderer &) = delete;
+	void record(const Command &command);
+	void discard();
+	void render(const Target &target);
+private:
+	static constexpr uint_type TILE_HEIGHT = 16;
+
+	Area screen;
+	std::vector<Command> commands;
+	std::vector<std::vector<uint32_t>> bins; // The commands over each tile, by index
+
+	Target target;
+	std::atomic<size_t> next_tile; // The first tile not taken yet
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, finished;
+	uint64_t generation; // Counts renders, so that workers tell a new one from a spurious wakeup
+	size_t working; // Workers not done with the current render
+	bool stopping;
+
+	void work();
+	void draw_tiles();
+	void draw_tile(size_t tile);
+};
+
+TiledRenderer::TiledRenderer(Area screen, unsigned threads) :
+	screen(screen),
+	bins((screen.h + TILE_HEIGHT - 1) / TILE_HEIGHT),
+	target{},
+	next_tile(0),
+	generation(0),
+	working(0),
+	stopping(false)
+{
+	for(unsigned i = 1; i < threads; ++i) workers.emplace_back(&TiledRenderer::work, this);
+}
+TiledRenderer::~TiledRenderer() {
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(std::thread &worker : workers) worker.join();
+}
+
+void TiledRenderer::record(const Command &command) {
+	const uint32_t index = commands.size();
+	commands.push_back(command);
+	const uint_type last = (command.pos.y + command.area.h - 1) / TILE_HEIGHT;
+	for(uint_type tile = command.pos.y / TILE_HEIGHT; tile <= last; ++tile) bins[tile].push_back(index);
+}
+
+void TiledRenderer::discard() {
+	commands.clear();
+	for(std::vector<uint32_t> &bin : bins) bin.clear();
+}
+
+void TiledRenderer::render(const Target &target) {
+	if(commands.empty()) return;
+	this->target = target;
+	next_tile = 0;
+	{
+		std::lock_guard lock(mutex);
+		working = workers.size();
+		++generation;
+	}
+	wake.notify_all();
+	draw_tiles();
+	{
+		std::unique_lock lock(mutex);
+		finished.wait(lock, [this] {return working == 0;});
+	}
+	discard();
+}
+
+void TiledRenderer::work() {
+	uint64_t rendered = 0;
+	std::unique_lock lock(mutex);
+	while(true) {
+		wake.wait(lock, [this, rendered] {return stopping || generation != rendered;});
+		if(stopping) return;
+		rendered = generation;
+		lock.unlock();
+		draw_tiles();
+		lock.lock();
+		if(--working == 0) finished.notify_one();
+	}
+}
+
+void TiledRenderer::draw_tiles() {
+	for(size_t tile; (tile = next_tile.fetch_add(1, std::memory_order_relaxed)) < bins.size();) draw_tile(tile);
+}
+
+void TiledRenderer::draw_tile(size_t tile) {
+	const uint_type top = tile * TILE_HEIGHT, bottom = std::min(top + TILE_HEIGHT, screen.h);
+	for(uint32_t index : bins[tile]) {
+		const Command &command = commands[index];
+		const UCoord pos = {command.pos.x, std::max(command.pos.y, top)};
+		const Area a = {command.area.w, std::min(command.pos.y + command.area.h, bottom) - pos.y};
+		uint8_t *row = target.pixels + pos.x * target.bytes_per_pixel + pos.y * target.line_length;
+		if(command.source) {
+			const uint32_t *source = command.source + (pos.y - command.pos.y) * command.source_width + pos.x - command.pos.x;
+			blit_rows(*target.functions, row, target.line_length, source, command.source_width, a, command.blend);
+		} else {
+			fill_rows(*target.functions, row, target.line_length, a, command.value, command.blend);
+		}
+	}
+}
+
+static void delete_tiled(TiledRenderer *tiled) {
+	delete tiled;
+}
+
 void Framebuffer::set(UCoord pos, Color c) {
 	assert(valid());
+	flush();
 	if(pos.x < 0 || pos.y < 0 || pos.x >= fbsize.w || pos.y >= fbsize.h) {
 		return;
 	}
-	uint32_t value;
-	if(if_blend && c.a != 255) {
-		Color prev = get({pos.x, pos.y});
-		double source = c.a / 255.0;
-		double dest = 1 - source;
-		value = (255 << 24) +
-			((int)(c.r * source + prev.r * dest) << 16) +
-			((int)(c.g * source + prev.g * dest) << 8) +
-			(int)(c.b * source + prev.b * dest);
-	} else {
-		value = (c.a << 24) + (c.r << 16) + (c.g << 8) + c.b;
-	}
-	*(uint32_t *)((if_nobuffer ? data : buffer) + pos.x * bytes_per_pixel + pos.y * line_length) = value;
+	mark_dirty(pos, {1, 1});
+	uint8_t *pixel = (if_nobuffer ? data : buffer) + pos.x * bytes_per_pixel + pos.y * line_length;
+	const uint32_t value = pixel_value(c);
+	(if_blend && c.a != 255 ? pixel_functions->blend_set : pixel_functions->set)(pixel, value);
 }
 
 Color Framebuffer::get(UCoord pos) const {
 	assert(valid());
+	flush();
 	if(pos.x < 0 || pos.y < 0 || pos.x >= fbsize.w || pos.y >= fbsize.h) {
 		throw FramebufferError("Coordinate out of bound");
 	}
-	uint32_t value = *(uint32_t *)((if_nobuffer ? data : buffer) + pos.x * bytes_per_pixel + pos.y * line_length);
-	Color output;
-	output.r = (value & 0x00ff0000) >> 16;
-	output.g = (value & 0x0000ff00) >> 8;
-	output.b = value & 0x000000ff;
-	output.a = value >> 24;
-	return output;
+	return pixel_color(pixel_functions->get((if_nobuffer ? data : buffer) + pos.x * bytes_per_pixel + pos.y * line_length));
 }
 
 void Framebuffer::fill(const Color c) {
-	assert(valid());
-	for(uint_type y = 0; y < fbsize.h; ++y) {
-		for(uint_type x = 0; x < fbsize.w; ++x) {
-			set({x, y}, {c.r, c.g, c.b ,c.a});
-		}
-	}
+	fill_rectangle({0, 0}, fbsize, c);
 }
 
 Area Framebuffer::size() const {
@@ -158,66 +907,976 @@ Area Framebuffer::size() const {
 	return fbsize;
 }
 
+void Framebuffer::mark_dirty(UCoord pos, Area a) {
+	if(if_nobuffer) return;
+	for(uint_type y = pos.y; y < pos.y + a.h; ++y) {
+		DirtySpan &span = dirty[y];
+		if(span.begin == span.end) {
+			span = {pos.x, pos.x + a.w};
+		} else {
+			span.begin = std::min(span.begin, pos.x);
+			span.end = std::max(span.end, pos.x + a.w);
+		}
+	}
+}
+
 void Framebuffer::update() {
 	assert(valid());
+	flush();
 	if(if_nobuffer) return;
-	memcpy(data, buffer, smem_len);
+	if(if_flipping && flip()) {
+		// The new hidden page is a frame behind, so what was drawn on the other one is copied over
+		reset_buffer();
+		return;
+	}
+	for(uint_type y = 0; y < fbsize.h; ++y) {
+		DirtySpan &span = dirty[y];
+		if(span.begin == span.end) continue;
+		const size_t offset = y * line_length + span.begin * bytes_per_pixel;
+		memcpy(front + offset, buffer + offset, (span.end - span.begin) * bytes_per_pixel);
+		span = {0, 0};
+	}
 }
 
 void Framebuffer::reset_buffer() {
 	assert(valid());
 	if(if_nobuffer) return;
-	memcpy(buffer, data, smem_len);
+	if(tiled) tiled->discard();
+	for(uint_type y = 0; y < fbsize.h; ++y) {
+		DirtySpan &span = dirty[y];
+		if(span.begin == span.end) continue;
+		const size_t offset = y * line_length + span.begin * bytes_per_pixel;
+		memcpy(buffer + offset, front + offset, (span.end - span.begin) * bytes_per_pixel);
+		span = {0, 0};
+	}
 }
 
-void Framebuffer::draw_rectangle(UCoord pos, Area a, Color c) {
+/*
+ * Make room for a second page below the first one in video memory, if the driver can pan between them.
+ * vinfo and finfo are updated to the new mode. Return whether pages can be flipped.
+ */
+bool Framebuffer::start_flipping(fb_var_screeninfo &vinfo, fb_fix_screeninfo &finfo) {
+	original_yres_virtual = vinfo.yres_virtual;
+	if(finfo.ypanstep == 0 || vinfo.yres % finfo.ypanstep != 0) return false;
+	if(finfo.smem_len < finfo.line_length * vinfo.yres * 2) return false;
+
+	fb_var_screeninfo flipping = vinfo;
+	flipping.yres_virtual = std::max(vinfo.yres_virtual, vinfo.yres * 2);
+	flipping.yoffset = 0;
+	if(flipping.yres_virtual != vinfo.yres_virtual || vinfo.yoffset != 0) {
+		if(ioctl(fbfd, FBIOPUT_VSCREENINFO, &flipping) < 0) return false;
+		if(ioctl(fbfd, FBIOGET_VSCREENINFO, &flipping) < 0 || ioctl(fbfd, FBIOGET_FSCREENINFO, &finfo) < 0 ||
+			flipping.yres_virtual < vinfo.yres * 2 || finfo.smem_len < finfo.line_length * vinfo.yres * 2) {
+			ioctl(fbfd, FBIOPUT_VSCREENINFO, &vinfo);
+			return false;
+		}
+	}
+	vinfo = flipping;
+	return true;
+}
+
+/*
+ * Show the hidden page, and hide the other one. Return false if the driver refused,
+ * and the pages stay as they were.
+ */
+bool Framebuffer::flip() {
+	var_info.yoffset = buffer == data ? 0 : fbsize.h;
+	var_info.activate = FB_ACTIVATE_VBL;
+	if(ioctl(fbfd, FBIOPAN_DISPLAY, &var_info) < 0) return false;
+	swap(front, buffer);
+	// The page hidden now may still be scanned out until the vertical blank
+	wait_for_vsync();
+	return true;
+}
+
+bool Framebuffer::wait_for_vsync() {
+	assert(valid());
+	if(!if_vsync) return false;
+	__u32 screen = 0;
+	if_vsync = ioctl(fbfd, FBIO_WAITFORVSYNC, &screen) == 0 || errno == EINTR;
+	return if_vsync;
+}
+
+double Framebuffer::refresh_rate() const {
+	assert(valid());
+	const fb_var_screeninfo &v = var_info;
+	const double line = double(v.left_margin) + v.xres + v.right_margin + v.hsync_len;
+	double lines = double(v.upper_margin) + v.yres + v.lower_margin + v.vsync_len;
+	if((v.vmode & FB_VMODE_MASK) == FB_VMODE_INTERLACED) lines /= 2;
+	if((v.vmode & FB_VMODE_MASK) == FB_VMODE_DOUBLE) lines *= 2;
+	if(v.pixclock == 0) return 0;
+	return 1e12 / (double(v.pixclock) * line * lines); // pixclock is in picoseconds
+}
+
+/*
+ * Leave the device as it was found, showing the first page.
+ */
+void Framebuffer::end_flipping() {
+	if(data && front != data) {
+		memcpy(data, front, fbsize.h * line_length);
+		var_info.yoffset = 0;
+		var_info.activate = FB_ACTIVATE_NOW;
+		ioctl(fbfd, FBIOPAN_DISPLAY, &var_info);
+	}
+	if(var_info.yres_virtual != original_yres_virtual) {
+		var_info.yres_virtual = original_yres_virtual;
+		var_info.yoffset = 0;
+		var_info.activate = FB_ACTIVATE_NOW;
+		ioctl(fbfd, FBIOPUT_VSCREENINFO, &var_info);
+	}
+}
+
+void Framebuffer::invalidate() {
+	assert(valid());
+	std::fill(dirty.begin(), dirty.end(), DirtySpan{0, fbsize.w});
+}
+
+Image Framebuffer::snapshot() const {
 	assert(valid());
-	for(uint_type x = 0; x < a.w; x++) {
-		set({pos.x + x, pos.y}, c);
-		set({pos.x + x, pos.y + a.h - 1}, c);
+	flush();
+	Image image(fbsize);
+	const uint8_t *row = if_nobuffer ? data : buffer;
+	for(uint_type y = 0; y < fbsize.h; ++y, row += line_length) {
+		for(uint_type x = 0; x < fbsize.w; ++x) {
+			image.pixels[y * fbsize.w + x] = pixel_functions->get(row + x * bytes_per_pixel);
+		}
+	}
+	return image;
+}
+
+/*
+ * Append value to file in big endian, as both PPM and PNG have it.
+ */
+static void append_big_endian(std::vector<uint8_t> &file, uint32_t value) {
+	for(int shift = 24; shift >= 0; shift -= 8) file.push_back(value >> shift);
+}
+
+/*
+ * The red, green and blue bytes of a pixel of image.
+ */
+static void append_rgb(std::vector<uint8_t> &file, const Image &image, UCoord pos) {
+	const uint32_t value = image.pixels[pos.y * image.size.w + pos.x];
+	file.insert(file.end(), {uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value)});
+}
+
+static std::vector<uint8_t> ppm_file(const Image &image) {
+	const std::string header = "P6\n" + std::to_string(image.size.w) + ' ' + std::to_string(image.size.h) + "\n255\n";
+	std::vector<uint8_t> file(header.begin(), header.end());
+	file.reserve(header.size() + image.pixels.size() * 3);
+	for(uint_type y = 0; y < image.size.h; ++y) {
+		for(uint_type x = 0; x < image.size.w; ++x) append_rgb(file, image, {x, y});
+	}
+	return file;
+}
+
+static uint32_t crc32(const uint8_t *bytes, size_t count) {
+	static constexpr auto TABLE = [] {
+		std::array<uint32_t, 256> table{};
+		for(uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for(int bit = 0; bit < 8; ++bit) c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		return table;
+	}();
+	uint32_t c = 0xffffffff;
+	for(size_t i = 0; i < count; ++i) c = TABLE[(c ^ bytes[i]) & 0xff] ^ (c >> 8);
+	return c ^ 0xffffffff;
+}
+
+static void append_png_chunk(std::vector<uint8_t> &file, const char *type, const std::vector<uint8_t> &content) {
+	append_big_endian(file, content.size());
+	const size_t start = file.size();
+	file.insert(file.end(), type, type + 4);
+	file.insert(file.end(), content.begin(), content.end());
+	append_big_endian(file, crc32(file.data() + start, file.size() - start));
+}
+
+/*
+ * An 8-bit RGB PNG, whose zlib stream is made of stored deflate blocks.
+ */
+static std::vector<uint8_t> png_file(const Image &image) {
+	std::vector<uint8_t> raw; // Each row after its filter type, which is none
+	raw.reserve(image.size.h * (1 + image.size.w * 3));
+	for(uint_type y = 0; y < image.size.h; ++y) {
+		raw.push_back(0);
+		for(uint_type x = 0; x < image.size.w; ++x) append_rgb(raw, image, {x, y});
+	}
+
+	constexpr size_t MAX_STORED = 65535;
+	std::vector<uint8_t> zlib = {0x78, 0x01};
+	zlib.reserve(2 + raw.size() + (raw.size() / MAX_STORED + 1) * 5 + 4);
+	size_t done = 0;
+	do {
+		const size_t count = std::min(raw.size() - done, MAX_STORED);
+		zlib.insert(zlib.end(), {uint8_t(done + count == raw.size()), uint8_t(count), uint8_t(count >> 8),
+			uint8_t(~count), uint8_t(~count >> 8)});
+		zlib.insert(zlib.end(), raw.begin() + done, raw.begin() + done + count);
+		done += count;
+	} while(done < raw.size());
+	uint32_t a = 1, b = 0; // Adler-32
+	for(uint8_t byte : raw) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
 	}
-	for(uint_type y = 0; y < a.h; y++) {
-		set({pos.x, pos.y + y}, c);
-		set({pos.x + a.w - 1, pos.y + y}, c);
+	append_big_endian(zlib, b << 16 | a);
+
+	std::vector<uint8_t> file = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	std::vector<uint8_t> header;
+	append_big_endian(header, image.size.w);
+	append_big_endian(header, image.size.h);
+	header.insert(header.end(), {8, 2, 0, 0, 0}); // Bit depth, RGB, and the only methods there are
+	append_png_chunk(file, "IHDR", header);
+	append_png_chunk(file, "IDAT", zlib);
+	append_png_chunk(file, "IEND", {});
+	return file;
+}
+
+/*
+ * Return 0, or errno if it couldn't be written.
+ */
+static int write_file(string_view file_name, const std::vector<uint8_t> &content) {
+	const int fd = open(std::string(file_name).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) return errno;
+	for(size_t done = 0; done < content.size();) {
+		const ssize_t written = write(fd, content.data() + done, content.size() - done);
+		if(written < 0) {
+			if(errno == EINTR) continue;
+			const int error = errno;
+			close(fd);
+			return error;
+		}
+		done += written;
+	}
+	return close(fd) < 0 ? errno : 0;
+}
+
+void Framebuffer::dump_ppm(string_view file_name) const {
+	if(const int error = write_file(file_name, ppm_file(snapshot()))) {
+		throw FramebufferError(strerror(error));
+	}
+}
+
+void Framebuffer::dump_png(string_view file_name) const {
+	if(const int error = write_file(file_name, png_file(snapshot()))) {
+		throw FramebufferError(strerror(error));
+	}
+}
+
+void Framebuffer::draw_rectangle(UCoord pos, Area a, Color c) {
+	assert(valid());
+	if(a.w == 0 || a.h == 0) return;
+	fill_span(pos, a.w, c);
+	if(a.h > 1) fill_span({pos.x, pos.y + a.h - 1}, a.w, c);
+	if(a.h > 2) {
+		fill_rectangle({pos.x, pos.y + 1}, {1, a.h - 2}, c);
+		if(a.w > 1) fill_rectangle({pos.x + a.w - 1, pos.y + 1}, {1, a.h - 2}, c);
 	}
 }
+void Framebuffer::fill_span(UCoord pos, uint_type length, Color c) {
+	fill_rectangle(pos, {length, 1}, c);
+}
 void Framebuffer::fill_rectangle(UCoord pos, Area a, Color c) {
 	assert(valid());
-	for(uint_type y = 0; y < a.h; y++) {
-		for(uint_type x = 0; x < a.w; x++) {
-			set({pos.x + x, pos.y + y}, c);
+	fill_or_record(pos, a, pixel_value(c), if_blend && c.a != 255);
+}
+
+/*
+ * fill_area(), or in tiled mode, record it.
+ */
+void Framebuffer::fill_or_record(UCoord pos, Area a, uint32_t value, bool blend) {
+	if(!tiled) {
+		fill_area(pos, a, value, blend);
+		return;
+	}
+	if(!clip(pos, a)) return;
+	mark_dirty(pos, a);
+	tiled->record({pos, a, nullptr, 0, value, blend});
+}
+
+/*
+ * Cut a at the edges of the screen, and return whether anything is left.
+ */
+bool Framebuffer::clip(UCoord pos, Area &a) const {
+	if(pos.x >= fbsize.w || pos.y >= fbsize.h) return false;
+	a.w = std::min(a.w, fbsize.w - pos.x);
+	a.h = std::min(a.h, fbsize.h - pos.y);
+	return a.w != 0 && a.h != 0;
+}
+/*
+ * fill_rectangle() with the color already converted, for primitives made of many rectangles.
+ */
+void Framebuffer::fill_area(UCoord pos, Area a, uint32_t value, bool blend) {
+	// Clip once, so that the rows below need no bound checks
+	if(!clip(pos, a)) return;
+
+	mark_dirty(pos, a);
+	uint8_t *row = (if_nobuffer ? data : buffer) + pos.x * bytes_per_pixel + pos.y * line_length;
+	if(!blend && a.w == fbsize.w && line_length == fbsize.w * bytes_per_pixel) {
+		// Whole rows without padding make a single span
+		pixel_functions->fill(row, a.w * a.h, value);
+		return;
+	}
+	fill_rows(*pixel_functions, row, line_length, a, value, blend);
+}
+
+void Framebuffer::blit(const Image &image, UCoord pos, BlendMode mode) {
+	assert(valid());
+	Area a = image.size;
+	if(!clip(pos, a)) return;
+
+	mark_dirty(pos, a);
+	const bool blend = mode == BlendMode::ALPHA;
+	if(tiled) {
+		tiled->record({pos, a, image.pixels.data(), image.size.w, 0, blend});
+		return;
+	}
+	uint8_t *row = (if_nobuffer ? data : buffer) + pos.x * bytes_per_pixel + pos.y * line_length;
+	blit_rows(*pixel_functions, row, line_length, image.pixels.data(), image.size.w, a, blend);
+}
+
+void Framebuffer::blit_scaled(const Image &image, URect dest, ScaleFilter filter, BlendMode mode) {
+	assert(valid());
+	UCoord pos = dest.coord;
+	Area a = dest.area;
+	if(image.size.w == 0 || image.size.h == 0 || !clip(pos, a)) return;
+	flush();
+
+	mark_dirty(pos, a);
+	const ImageScaler scaler(image, dest.area, filter, 0, a.w);
+	const auto draw_row = mode == BlendMode::ALPHA ? pixel_functions->blend : pixel_functions->copy;
+	uint8_t *const corner = (if_nobuffer ? data : buffer) + pos.x * bytes_per_pixel + pos.y * line_length;
+	parallel_rows(a.h, a.w, [this, &scaler, draw_row, corner, a](uint_type first, uint_type last) {
+		scaler.scale_rows(first, last, [this, draw_row, corner, a](uint_type y, const uint32_t *row) {
+			draw_row(corner + y * line_length, row, a.w);
+		});
+	});
+}
+
+NativeImage Framebuffer::convert(const Image &image, Area size, ScaleFilter filter) const {
+	assert(valid());
+	NativeImage result{size, std::vector<uint8_t>(size.w * size.h * bytes_per_pixel), pixel_functions};
+	if(size.w == 0 || size.h == 0 || image.size.w == 0 || image.size.h == 0) return result;
+	const ImageScaler scaler(image, size, filter, 0, size.w);
+	const size_t row_length = size.w * bytes_per_pixel;
+	parallel_rows(size.h, size.w, [this, &scaler, &result, row_length](uint_type first, uint_type last) {
+		scaler.scale_rows(first, last, [this, &result, row_length](uint_type y, const uint32_t *row) {
+			pixel_functions->copy(&result.pixels[y * row_length], row, result.size.w);
+		});
+	});
+	return result;
+}
+
+void Framebuffer::blit(const NativeImage &image, UCoord pos) {
+	assert(valid() && compatible(image));
+	Area a = image.size;
+	if(!clip(pos, a)) return;
+	flush();
+
+	mark_dirty(pos, a);
+	const size_t row_length = image.size.w * bytes_per_pixel;
+	uint8_t *row = (if_nobuffer ? data : buffer) + pos.x * bytes_per_pixel + pos.y * line_length;
+	if(a.w == fbsize.w && line_length == row_length) {
+		memcpy(row, image.pixels.data(), row_length * a.h);
+		return;
+	}
+	const uint8_t *source = image.pixels.data();
+	for(uint_type y = 0; y < a.h; ++y, row += line_length, source += row_length) memcpy(row, source, a.w * bytes_per_pixel);
+}
+
+void Framebuffer::set_tiled(unsigned threads) {
+	assert(valid());
+	flush();
+	delete_tiled(tiled);
+	tiled = threads ? new TiledRenderer(fbsize, threads) : nullptr;
+}
+
+void Framebuffer::render() {
+	assert(valid());
+	flush();
+}
+
+/*
+ * Draw what was recorded in tiled mode. The pixels aren't part of the state of Framebuffer,
+ * so that reading them can render first.
+ */
+void Framebuffer::flush() const {
+	if(tiled) tiled->render({if_nobuffer ? data : buffer, line_length, bytes_per_pixel, pixel_functions});
+}
+
+/*
+ * A line that takes major_length steps along one axis, and minor_length <= major_length along the other.
+ * After step i, the minor axis has moved offset(i) = round(i * minor_length / major_length), as in Bresenham's
+ * algorithm. The steps with the same offset make a run, so that the line can be drawn as spans.
+ */
+struct LineRuns {
+	uint_type major_length, minor_length;
+
+	uint_type offset(uint_type step) const {
+		return (2 * step * minor_length + major_length) / (2 * major_length);
+	}
+	uint_type first_step(uint_type run) const {
+		if(run == 0) return 0;
+		if(run > minor_length) return major_length + 1;
+		return (2 * run * major_length - major_length + 2 * minor_length - 1) / (2 * minor_length);
+	}
+};
+
+/*
+ * The steps [begin, end) out of length + 1 from start, forward or backward, that stay within [0, limit).
+ */
+static std::pair<uint_type, uint_type> visible_steps(uint_type start, bool forward, uint_type length, uint_type limit) {
+	if(forward) return {0, start < limit ? std::min(length + 1, limit - start) : 0};
+	return {start >= limit ? start - limit + 1 : 0, std::min(length, start) + 1};
+}
+
+void Framebuffer::draw_line_runs(UCoord from, UCoord to, uint32_t value, bool blend, bool skip_first, bool skip_last) {
+	const bool x_forward = to.x >= from.x, y_forward = to.y >= from.y;
+	const Area delta = {x_forward ? to.x - from.x : from.x - to.x, y_forward ? to.y - from.y : from.y - to.y};
+	if(delta.w == 0 && delta.h == 0) {
+		if(!skip_first && !skip_last) fill_area(from, {1, 1}, value, blend);
+		return;
+	}
+
+	const bool steep = delta.h > delta.w;
+	const LineRuns line = steep ? LineRuns{delta.h, delta.w} : LineRuns{delta.w, delta.h};
+	const uint_type major_start = steep ? from.y : from.x, minor_start = steep ? from.x : from.y;
+	const bool major_forward = steep ? y_forward : x_forward, minor_forward = steep ? x_forward : y_forward;
+
+	// Clip once: the steps within the screen along the major axis, then the runs within it along the other
+	auto [step_begin, step_end] = visible_steps(major_start, major_forward, line.major_length, steep ? fbsize.h : fbsize.w);
+	if(skip_first) step_begin = std::max<uint_type>(step_begin, 1);
+	if(skip_last) step_end = std::min(step_end, line.major_length);
+	if(step_begin >= step_end) return;
+	auto [run_begin, run_end] = visible_steps(minor_start, minor_forward, line.minor_length, steep ? fbsize.w : fbsize.h);
+	run_begin = std::max(run_begin, line.offset(step_begin));
+	run_end = std::min(run_end, line.offset(step_end - 1) + 1);
+
+	// Runs across rows, and runs of a single pixel, are written a pixel at a time
+	const auto set_pixel = blend ? pixel_functions->blend_set : pixel_functions->set;
+	uint8_t *const pixels = if_nobuffer ? data : buffer;
+	for(uint_type run = run_begin; run < run_end; ++run) {
+		const uint_type begin = std::max(line.first_step(run), step_begin);
+		const uint_type end = std::min(line.first_step(run + 1), step_end);
+		const uint_type major = major_forward ? major_start + begin : major_start - (end - 1);
+		const uint_type minor = minor_forward ? minor_start + run : minor_start - run;
+		if(!steep && end - begin > 1) {
+			fill_area({major, minor}, {end - begin, 1}, value, blend);
+			continue;
+		}
+		const UCoord pos = steep ? UCoord{minor, major} : UCoord{major, minor};
+		mark_dirty(pos, steep ? Area{1, end - begin} : Area{1, 1});
+		uint8_t *pixel = pixels + pos.x * bytes_per_pixel + pos.y * line_length;
+		for(uint_type i = begin; i < end; ++i, pixel += line_length) {
+			// Hardware prefetchers don't follow strides across pages
+			__builtin_prefetch(pixel + PREFETCH_ROWS * line_length, 1);
+			set_pixel(pixel, value);
 		}
 	}
 }
 
 void Framebuffer::draw_line(UCoord c1, UCoord c2, Color color) {
-	if(c1.x == c2.x) {
-		// To ensure that c1.y <= c2.y
-		if(c2.y < c1.y) swap(c1.y, c2.y);
-		fill_rectangle({c1.x, c1.y}, {1, c2.y - c1.y + 1}, color);
+	assert(valid());
+	flush();
+	draw_line_runs(c1, c2, pixel_value(color), if_blend && color.a != 255, false, false);
+}
+
+void Framebuffer::draw_lines(const std::vector<std::pair<UCoord, UCoord>> &lines, Color color) {
+	assert(valid());
+	flush();
+	const uint32_t value = pixel_value(color);
+	const bool blend = if_blend && color.a != 255;
+	for(const auto &[c1, c2] : lines) draw_line_runs(c1, c2, value, blend, false, false);
+}
+
+void Framebuffer::draw_polyline(const std::vector<UCoord> &points, Color color, bool closed) {
+	assert(valid());
+	flush();
+	if(points.empty()) return;
+	const uint32_t value = pixel_value(color);
+	const bool blend = if_blend && color.a != 255;
+	// Every point is drawn once, so that joints aren't blended twice
+	draw_line_runs(points[0], points[0], value, blend, false, false);
+	for(size_t i = 1; i < points.size(); ++i) draw_line_runs(points[i - 1], points[i], value, blend, true, false);
+	if(closed && points.size() > 2) draw_line_runs(points.back(), points[0], value, blend, true, true);
+}
+
+void Framebuffer::draw_line_antialiased(UCoord c1, UCoord c2, Color color) {
+	assert(valid());
+	flush();
+	const Area delta = {c1.x > c2.x ? c1.x - c2.x : c2.x - c1.x, c1.y > c2.y ? c1.y - c2.y : c2.y - c1.y};
+	if(delta.w == 0 || delta.h == 0 || delta.w == delta.h) {
+		draw_line(c1, c2, color); // Nothing to smooth
+		return;
+	}
+
+	// Xiaolin Wu's algorithm: walk forward along the major axis, and split each step between the two
+	// nearest pixels across it, by the fraction of the minor position in 0.32 fixed point
+	const bool steep = delta.h > delta.w;
+	if((steep ? c1.y : c1.x) > (steep ? c2.y : c2.x)) swap(c1, c2);
+	const uint_type major_length = steep ? delta.h : delta.w, minor_length = steep ? delta.w : delta.h;
+	const uint_type major_start = steep ? c1.y : c1.x, minor_start = steep ? c1.x : c1.y;
+	const bool minor_forward = steep ? c2.x > c1.x : c2.y > c1.y;
+	const uint_type major_limit = steep ? fbsize.h : fbsize.w;
+	if(major_start >= major_limit) return;
+	const uint_type last = std::min(major_length, major_limit - 1 - major_start);
+	// Rounded up, so that the last step lands on c2 exactly
+	const uint64_t slope = ((uint64_t(minor_length) << 32) + major_length - 1) / major_length;
+
+	const uint32_t value = pixel_value(color) & 0x00ffffff;
+	const uint_type minor_limit = steep ? fbsize.w : fbsize.h;
+	const size_t major_stride = steep ? line_length : bytes_per_pixel, minor_stride = steep ? bytes_per_pixel : line_length;
+	uint8_t *const base = if_nobuffer ? data : buffer;
+	const auto blend_set = pixel_functions->blend_set;
+	constexpr uint_type PREFETCH_STEPS = 32;
+	// Steps on the same pair of pixels across are marked dirty together
+	uint_type run_start = major_start, run_low = 0;
+	const auto mark_run = [this, steep, minor_limit](uint_type begin, uint_type end, uint_type low) {
+		const uint_type first = low < minor_limit ? low : low + 1;
+		if(begin == end || first >= minor_limit) return;
+		const uint_type count = first + 1 < minor_limit && first == low ? 2 : 1;
+		mark_dirty(steep ? UCoord{first, begin} : UCoord{begin, first}, steep ? Area{count, end - begin} : Area{end - begin, count});
+	};
+	for(uint_type step = 0; step <= last; ++step) {
+		const uint64_t position = step * slope;
+		const uint_type offset = position >> 32;
+		const uint32_t weight = (position >> 24) & 0xff; // How much of the step belongs to the next pixel
+		// The two pixels of a step: low is the one nearer to minor 0, and high the one after it
+		const uint_type near = minor_forward ? minor_start + offset : minor_start - offset;
+		const uint_type low = minor_forward || weight == 0 ? near : near - 1;
+		const uint32_t low_alpha = weight == 0 ? color.a : color.a * (minor_forward ? 255 - weight : weight) / 255;
+		const uint32_t high_alpha = color.a - low_alpha;
+		const uint_type major = major_start + step;
+		if(low != run_low) {
+			mark_run(run_start, major, run_low);
+			run_start = major;
+			run_low = low;
+		}
+		uint8_t *const pixel = base + major * major_stride;
+		// Blending reads every pixel, and the rows change too often for hardware prefetchers to follow
+		const uint_type ahead_offset = (step + PREFETCH_STEPS) * slope >> 32;
+		uint8_t *const ahead = pixel + PREFETCH_STEPS * major_stride
+			+ (minor_forward ? minor_start + ahead_offset : minor_start - ahead_offset) * minor_stride;
+		__builtin_prefetch(ahead, 1);
+		__builtin_prefetch(minor_forward ? ahead + minor_stride : ahead - minor_stride, 1);
+		if(low < minor_limit && low_alpha != 0) blend_set(pixel + low * minor_stride, value | low_alpha << 24);
+		if(low + 1 < minor_limit && high_alpha != 0) blend_set(pixel + (low + 1) * minor_stride, value | high_alpha << 24);
+	}
+	mark_run(run_start, major_start + last + 1, run_low);
+}
+
+/*
+ * Collects the spans of a shape row by row, and fills those that stay the same over consecutive rows
+ * as one rectangle, so that straight sides cost a fill per run of rows rather than per row.
+ * Spans are [begin, end) in pixels, on the screen and in order from left to right.
+ */
+template<typename Fill>
+class SpanRows {
+public:
+	SpanRows(Fill fill) : fill(fill), top(0), bottom(0) {}
+	void add(int_type begin, int_type end) {
+		if(begin < end) current.push_back({begin, end});
+	}
+	/*
+	 * Done with the spans added for row y.
+	 */
+	void end_row(int_type y) {
+		if(y == bottom && current == previous && !current.empty()) {
+			++bottom;
+		} else {
+			flush();
+			swap(previous, current);
+			top = y;
+			bottom = y + 1;
+		}
+		current.clear();
+	}
+	void finish() {
+		flush();
+	}
+private:
+	void flush() {
+		for(const auto &[begin, end] : previous) {
+			fill(UCoord{uint_type(begin), uint_type(top)}, Area{uint_type(end - begin), uint_type(bottom - top)});
+		}
+		previous.clear();
+	}
+
+	Fill fill;
+	std::vector<std::pair<int_type, int_type>> previous, current; // Spans of the rows from top to bottom, and of the next one
+	int_type top, bottom;
+};
+
+/*
+ * The first pixel whose center isn't left of x, limited to [0, limit].
+ */
+static int_type pixel_edge(double x, uint_type limit) {
+	const double edge = std::ceil(x - 0.5);
+	if(!(edge > 0)) return 0; // NaN included
+	return edge < double(limit) ? int_type(edge) : int_type(limit);
+}
+
+template<typename Outer, typename Inner>
+void Framebuffer::fill_rows_between(double top, double bottom, Outer outer, Inner inner, Color c) {
+	assert(valid());
+	const uint32_t value = pixel_value(c);
+	const bool blend = if_blend && c.a != 255;
+	SpanRows rows([this, value, blend](UCoord pos, Area a) {fill_or_record(pos, a, value, blend);});
+	const int_type first = pixel_edge(top, fbsize.h), last = pixel_edge(bottom, fbsize.h);
+	for(int_type y = first; y < last; ++y) {
+		const double center = y + 0.5;
+		const auto [left, right] = outer(center);
+		const int_type begin = pixel_edge(left, fbsize.w), end = pixel_edge(right, fbsize.w);
+		const auto [inner_left, inner_right] = inner(center);
+		if(inner_left < inner_right) {
+			rows.add(begin, std::min(end, pixel_edge(inner_left, fbsize.w)));
+			rows.add(std::max(begin, pixel_edge(inner_right, fbsize.w)), end);
+		} else {
+			rows.add(begin, end);
+		}
+		rows.end_row(y);
+	}
+	rows.finish();
+}
+
+/*
+ * Where the rows of an ellipse cross center, as [left, right) from the left side to the right one.
+ * Outside of it, left >= right.
+ */
+static std::pair<double, double> ellipse_row(Point center, double radius_x, double radius_y, double y) {
+	if(radius_x <= 0 || radius_y <= 0) return {0, 0};
+	const double t = (y - center.y) / radius_y;
+	if(t <= -1 || t >= 1) return {0, 0};
+	const double half = radius_x * std::sqrt(1 - t * t);
+	return {center.x - half, center.x + half};
+}
+
+void Framebuffer::fill_ellipse(Point center, double radius_x, double radius_y, Color c) {
+	const auto outer = [=](double y) {return ellipse_row(center, radius_x, radius_y, y);};
+	const auto none = [](double) {return std::pair<double, double>{0, 0};};
+	fill_rows_between(center.y - radius_y, center.y + radius_y, outer, none, c);
+}
+
+void Framebuffer::draw_ellipse(Point center, double radius_x, double radius_y, Color c, double thickness) {
+	const auto outer = [=](double y) {return ellipse_row(center, radius_x, radius_y, y);};
+	const auto inner = [=](double y) {return ellipse_row(center, radius_x - thickness, radius_y - thickness, y);};
+	fill_rows_between(center.y - radius_y, center.y + radius_y, outer, inner, c);
+}
+
+/*
+ * The same as ellipse_row() for a rounded rectangle.
+ */
+static std::pair<double, double> rounded_rectangle_row(Point top_left, Point bottom_right, double radius, double y) {
+	if(y < top_left.y || y >= bottom_right.y || top_left.x >= bottom_right.x) return {0, 0};
+	radius = std::clamp(radius, 0.0, std::min(bottom_right.x - top_left.x, bottom_right.y - top_left.y) / 2);
+	// How far the row is into the arc of a corner
+	const double into = std::max({top_left.y + radius - y, y - (bottom_right.y - radius), 0.0});
+	const double inset = radius - std::sqrt(std::max(radius * radius - into * into, 0.0));
+	return {top_left.x + inset, bottom_right.x - inset};
+}
+
+void Framebuffer::fill_rounded_rectangle(Point top_left, Point bottom_right, double radius, Color c) {
+	const auto outer = [=](double y) {return rounded_rectangle_row(top_left, bottom_right, radius, y);};
+	const auto none = [](double) {return std::pair<double, double>{0, 0};};
+	fill_rows_between(top_left.y, bottom_right.y, outer, none, c);
+}
+
+void Framebuffer::draw_rounded_rectangle(Point top_left, Point bottom_right, double radius, Color c, double thickness) {
+	const Point inner_top_left = {top_left.x + thickness, top_left.y + thickness};
+	const Point inner_bottom_right = {bottom_right.x - thickness, bottom_right.y - thickness};
+	const auto outer = [=](double y) {return rounded_rectangle_row(top_left, bottom_right, radius, y);};
+	const auto inner = [=](double y) {return rounded_rectangle_row(inner_top_left, inner_bottom_right, radius - thickness, y);};
+	fill_rows_between(top_left.y, bottom_right.y, outer, inner, c);
+}
+
+/*
+ * Coordinates of polygons are in 1/256 of a pixel, and walked exactly in integers.
+ */
+constexpr int_type SUBPIXEL_BITS = 8, SUBPIXELS = 1 << SUBPIXEL_BITS;
+constexpr double MAX_COORDINATE = 1 << 22; // In pixels, so that products of subpixels fit in 64 bits
+
+static int_type floor_div(int_type a, int_type b) {
+	return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+/*
+ * An edge of a polygon in the active edge table, going down from its top.
+ * Its x where it crosses the center of the current row is x + error / height, with 0 <= error < height.
+ */
+struct PolygonEdge {
+	int_type first_row, end_row; // The rows whose centers it crosses
+	int_type x, error;
+	int_type step, step_error; // How much x changes from row to row
+	int_type height;
+	int winding; // 1 going down, -1 going up
+
+	PolygonEdge(int_type x0, int_type y0, int_type x1, int_type y1, int winding) : height(y1 - y0), winding(winding) {
+		first_row = floor_div(y0 - SUBPIXELS / 2 + SUBPIXELS - 1, SUBPIXELS);
+		end_row = floor_div(y1 - SUBPIXELS / 2 + SUBPIXELS - 1, SUBPIXELS);
+		const int_type width = x1 - x0;
+		step = floor_div(width * SUBPIXELS, height);
+		step_error = width * SUBPIXELS - step * height;
+		start(x0, y0, width, first_row);
+	}
+	/*
+	 * Move to the center of row.
+	 */
+	void start(int_type x0, int_type y0, int_type width, int_type row) {
+		const int_type n = width * (row * SUBPIXELS + SUBPIXELS / 2 - y0);
+		x = x0 + floor_div(n, height);
+		error = n - (x - x0) * height;
+	}
+	void next_row() {
+		x += step;
+		error += step_error;
+		if(error >= height) {
+			error -= height;
+			++x;
+		}
+	}
+	/*
+	 * The first pixel whose center is at x or right of it.
+	 */
+	int_type pixel() const {
+		const int_type v = x - SUBPIXELS / 2;
+		return error == 0 ? floor_div(v + SUBPIXELS - 1, SUBPIXELS) : floor_div(v, SUBPIXELS) + 1;
+	}
+};
+
+void Framebuffer::fill_polygon(const std::vector<Point> &points, Color c) {
+	assert(valid());
+	if(points.size() < 3) return;
+	const auto subpixels = [](double v) {
+		return int_type(std::llround(std::clamp(v, -MAX_COORDINATE, MAX_COORDINATE) * SUBPIXELS));
+	};
+
+	// The edge table, by first row. Horizontal edges cross no row center.
+	std::vector<PolygonEdge> edges;
+	for(size_t i = 0; i < points.size(); ++i) {
+		const Point &from = points[i], &to = points[(i + 1) % points.size()];
+		int_type x0 = subpixels(from.x), y0 = subpixels(from.y), x1 = subpixels(to.x), y1 = subpixels(to.y);
+		if(y0 == y1) continue;
+		const int winding = y0 < y1 ? 1 : -1;
+		if(y0 > y1) {
+			swap(x0, x1);
+			swap(y0, y1);
+		}
+		PolygonEdge edge(x0, y0, x1, y1, winding);
+		if(edge.first_row >= edge.end_row || edge.end_row <= 0 || edge.first_row >= int_type(fbsize.h)) continue;
+		if(edge.first_row < 0) {
+			edge.start(x0, y0, x1 - x0, 0);
+			edge.first_row = 0;
+		}
+		edges.push_back(edge);
+	}
+	if(edges.empty()) return;
+	std::sort(edges.begin(), edges.end(), [](const PolygonEdge &a, const PolygonEdge &b) {return a.first_row < b.first_row;});
+
+	const uint32_t value = pixel_value(c);
+	const bool blend = if_blend && c.a != 255;
+	SpanRows rows([this, value, blend](UCoord pos, Area a) {fill_or_record(pos, a, value, blend);});
+	std::vector<PolygonEdge> active;
+	std::vector<std::pair<int_type, int>> crossings; // Pixel and winding of each active edge
+	size_t next = 0;
+	for(int_type y = edges[0].first_row; y < int_type(fbsize.h) && (next < edges.size() || !active.empty()); ++y) {
+		std::erase_if(active, [y](const PolygonEdge &edge) {return edge.end_row <= y;});
+		for(; next < edges.size() && edges[next].first_row == y; ++next) active.push_back(edges[next]);
+
+		crossings.clear();
+		for(const PolygonEdge &edge : active) crossings.push_back({edge.pixel(), edge.winding});
+		std::sort(crossings.begin(), crossings.end());
+		int winding = 0;
+		int_type begin = 0;
+		for(const auto &[pixel, direction] : crossings) {
+			if(winding == 0) begin = pixel;
+			winding += direction;
+			if(winding == 0) {
+				rows.add(std::clamp(begin, int_type(0), int_type(fbsize.w)), std::clamp(pixel, int_type(0), int_type(fbsize.w)));
+			}
+		}
+		rows.end_row(y);
+		for(PolygonEdge &edge : active) edge.next_row();
+	}
+	rows.finish();
+}
+
+BitmapFont::BitmapFont(Area glyph_size) : size(glyph_size) {
+	assert(glyph_size.w <= 32 && glyph_size.h != 0);
+	glyph_indices.fill(NO_GLYPH);
+}
+
+const BitmapFont &BitmapFont::packed() {
+	static const BitmapFont font = [] {
+		constexpr Area size = PACKED_FONT_CHARACTER_SIZE;
+		BitmapFont font(size);
+		bool pixels[size.w * size.h];
+		for(char c = '!'; c <= '~'; ++c) {
+			if(c >= 'a' && c <= 'z') continue;
+			const size_t first = packed_font_index(c) * size.w * size.h;
+			for(size_t i = 0; i < size.w * size.h; ++i) {
+				const size_t bit = first + i;
+				pixels[i] = (PACKED_FONT_DATA[bit / 4] - 'A') >> (3 - bit % 4) & 1;
+			}
+			font.set_glyph(c, pixels);
+			if(c >= 'A' && c <= 'Z') font.set_glyph(c - 'A' + 'a', pixels);
+		}
+		return font;
+	}();
+	return font;
+}
+
+void BitmapFont::set_glyph(unsigned char c, const bool *pixels) {
+	if(glyph_indices[c] == NO_GLYPH) {
+		glyph_indices[c] = rows.size() / size.h;
+		rows.resize(rows.size() + size.h);
+	}
+	uint32_t *row = &rows[glyph_indices[c] * size.h];
+	for(uint_type y = 0; y < size.h; ++y, ++row) {
+		*row = 0;
+		for(uint_type x = 0; x < size.w; ++x) *row |= uint32_t(pixels[y * size.w + x]) << x;
+	}
+}
+
+Area BitmapFont::text_size(string_view text, uint_type scale) const {
+	uint_type lines = 1, columns = 0, widest = 0;
+	for(char c : text) {
+		if(c == '\n') {
+			++lines;
+			columns = 0;
+		} else {
+			widest = std::max(widest, ++columns);
+		}
+	}
+	return {widest * size.w * scale, lines * size.h * scale};
+}
+
+Area Framebuffer::draw_text(const BitmapFont &font, UCoord pos, string_view text, Color c, uint_type scale) {
+	assert(valid());
+	flush();
+	const Area text_area = font.text_size(text, scale);
+	Area visible = text_area;
+	if(scale == 0 || !clip(pos, visible)) return text_area;
+
+	mark_dirty(pos, visible);
+	const uint32_t value = pixel_value(c);
+	const auto fill_run = if_blend && c.a != 255 ? pixel_functions->blend_fill : pixel_functions->fill;
+	const Area cell = {font.glyph_size().w * scale, font.glyph_size().h * scale};
+	uint8_t *const pixels = if_nobuffer ? data : buffer;
+	UCoord cursor = pos;
+	for(char character : text) {
+		if(character == '\n') {
+			cursor = {pos.x, cursor.y + cell.h};
+			continue;
+		}
+		const uint32_t *glyph = font.glyph(character);
+		if(glyph && cursor.x < fbsize.w && cursor.y < fbsize.h) {
+			// Cut at the edges of the screen, to the pixel
+			const Area shown = {std::min(cell.w, fbsize.w - cursor.x), std::min(cell.h, fbsize.h - cursor.y)};
+			uint8_t *row = pixels + cursor.x * bytes_per_pixel + cursor.y * line_length;
+			for(uint_type y = 0; y < shown.h; ++y, row += line_length) {
+				// Every run of set bits is a span
+				for(uint32_t bits = glyph[y / scale]; bits != 0;) {
+					const int start = std::countr_zero(bits);
+					const int length = std::countr_one(bits >> start);
+					const uint_type begin = start * scale, end = std::min((start + length) * scale, shown.w);
+					if(begin >= shown.w) break;
+					fill_run(row + begin * bytes_per_pixel, end - begin, value);
+					bits = start + length == 32 ? 0 : bits & ~0u << (start + length);
+				}
+			}
+		}
+		cursor.x += cell.w;
+	}
+	return text_area;
+}
+
+/*
+ * Seconds of CLOCK_MONOTONIC, which timerfd counts in too.
+ */
+static double monotonic_seconds() {
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+FrameScheduler::FrameScheduler(Framebuffer &fb_, Mode mode, double target_fps) :
+	fb(fb_), timerfd(-1), period(0), last_shown(0), m_frames(0), m_missed(0) {
+	assert(fb.valid());
+	const double refresh_rate = fb.refresh_rate();
+	if(mode == Mode::VSYNC && fb.wait_for_vsync()) {
+		if(refresh_rate > 0) period = 1 / refresh_rate;
 		return;
 	}
-	// To ensure that c1.x < c2.x
-	if(c1.x > c2.x) swap(c1, c2);
-	if(c1.y > c2.y) {
-		double width = c2.x - c1.x + 1;
-		uint_type height = c1.y - c2.y + 1;
-		for(uint_type x = c1.x; x <= c2.x; ++x) {
-			uint_type y1 = c1.y - static_cast<uint_type>(std::floor((x - c1.x) * height / width));
-			uint_type y2 = c1.y - static_cast<uint_type>(std::ceil((x + 1 - c1.x) * height / width));
-			fill_rectangle({x, y2}, {1, y1 - y2}, color);
-		}
-	} else if(c1.y < c2.y) {
-		double width = c2.x - c1.x + 1;
-		uint_type height = c2.y - c1.y + 1;
-		for(uint_type x = c1.x; x <= c2.x; ++x) {
-			uint_type y1 = c1.y + static_cast<uint_type>(std::floor((x - c1.x) * height / width));
-			uint_type y2 = c1.y + static_cast<uint_type>(std::ceil((x + 1 - c1.x) * height / width));
-			fill_rectangle({x, y1}, {1, y2 - y1}, color);
+	if(mode == Mode::VSYNC) target_fps = refresh_rate > 0 ? refresh_rate : DEFAULT_REFRESH_RATE;
+	start_timer(target_fps > 0 ? target_fps : DEFAULT_REFRESH_RATE);
+}
+
+FrameScheduler::~FrameScheduler() {
+	if(timerfd >= 0) close(timerfd);
+}
+
+/*
+ * Pace the frames by a timer from now on, instead of vsync.
+ */
+void FrameScheduler::start_timer(double fps) {
+	timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	if(timerfd < 0) {
+		throw FramebufferError(strerror(errno));
+	}
+	period = 1 / fps;
+	if(!arm_timer()) {
+		const int error = errno;
+		close(timerfd);
+		timerfd = -1;
+		throw FramebufferError(strerror(error));
+	}
+}
+
+/*
+ * Make the next frame due a period from now, and those after it a period apart.
+ */
+bool FrameScheduler::arm_timer() {
+	const long nanoseconds = std::lround(period * 1e9);
+	itimerspec spec = {};
+	spec.it_interval = {nanoseconds / 1000000000, nanoseconds % 1000000000};
+	spec.it_value = spec.it_interval;
+	return timerfd_settime(timerfd, 0, &spec, nullptr) == 0;
+}
+
+void FrameScheduler::present() {
+	if(timerfd < 0) {
+		// update() waits itself after flipping the pages
+		const bool waited = fb.page_flipping() || fb.wait_for_vsync();
+		fb.update();
+		if(!waited || !fb.vsync()) {
+			start_timer(period > 0 ? 1 / period : DEFAULT_REFRESH_RATE);
+			++m_frames;
+			return;
 		}
+		const double now = monotonic_seconds();
+		if(m_frames != 0) {
+			const double interval = now - last_shown;
+			// The shortest interval stands for the period, where the video mode doesn't tell it
+			if(fb.refresh_rate() <= 0 && (period == 0 || interval < period)) period = interval;
+			if(period > 0) m_missed += std::max<int64_t>(std::llround(interval / period) - 1, 0);
+		}
+		last_shown = now;
+		++m_frames;
+		return;
+	}
+	// Periods that have passed since the last frame without one being shown
+	uint64_t expirations = 0;
+	if(read(timerfd, &expirations, sizeof(expirations)) > 0) {
+		// Late, or the first frame: shown right away, and the following ones pushed back
+		if(m_frames != 0) m_missed += expirations;
+		arm_timer();
 	} else {
-		fill_rectangle({c1.x, c1.y}, {c2.x - c1.x + 1, 1}, color);
+		pollfd due = {timerfd, POLLIN, 0};
+		while(poll(&due, 1, -1) < 0 && errno == EINTR) {}
+		if(read(timerfd, &expirations, sizeof(expirations)) > 0 && expirations > 1) m_missed += expirations - 1;
 	}
+	fb.update();
+	++m_frames;
 }
 
 #endif
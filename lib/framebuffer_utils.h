@@ -3,12 +3,16 @@
 #define __FRAMEBUFFER_UTILS_H__
 
 #include <string>
+#include <vector>
+#include <utility>
+#include <array>
 #include <linux/fb.h>
 #include <cstdint>
 #include <utils.h>
 
 class FramebufferError : std::exception {
 	friend class Framebuffer;
+	friend class FrameScheduler;
 public:
 	virtual const char *what() const noexcept override {return msg.c_str();}
 private:
@@ -17,6 +21,95 @@ private:
 	std::string msg;
 };
 
+/*
+ * How the pixels of an image are combined with those on the framebuffer.
+ */
+enum class BlendMode {
+	REPLACE, // Pixels are written as they are, alpha included
+	ALPHA, // Pixels are drawn over by their alpha, and the result is opaque
+};
+
+/*
+ * How an image is sampled when it's drawn at another size.
+ */
+enum class ScaleFilter {
+	NEAREST, // The source pixel under the center of each pixel
+	BILINEAR, // The four source pixels around the center of each pixel, weighted by how close they are
+};
+
+/*
+ * A point with fractions of pixels. The pixel at (x, y) spans from (x, y) to (x + 1, y + 1),
+ * so that its center is at (x + 0.5, y + 0.5).
+ */
+struct Point {double x, y;};
+
+/*
+ * Pixels in memory, row by row, in the 32-bit layout of the framebuffer (0xAARRGGBB).
+ */
+struct Image {
+	Area size;
+	std::vector<uint32_t> pixels;
+
+	Image() : size{0, 0} {}
+	Image(Area size, Color c = {0, 0, 0, 0});
+	Color get(UCoord pos) const;
+	void set(UCoord pos, Color c);
+	/*
+	 * The image stretched to size, with the rows of large ones scaled on several threads.
+	 */
+	Image scaled(Area size, ScaleFilter filter = ScaleFilter::BILINEAR) const;
+};
+
+/*
+ * The glyphs of a bitmap font, unpacked into a bitmask per row, with the leftmost pixel in the lowest bit,
+ * so that Framebuffer::draw_text() draws each run of set bits as a span.
+ * Glyphs are at most 32 pixels wide, and all of the same size.
+ */
+class BitmapFont {
+public:
+	BitmapFont(Area glyph_size);
+	/*
+	 * The font of packed_font.h, with its lowercase letters drawn as the uppercase ones.
+	 */
+	static const BitmapFont &packed();
+
+	Area glyph_size() const {return size;}
+	/*
+	 * Make pixels, glyph_size().w * glyph_size().h of them row by row, the glyph of c.
+	 */
+	void set_glyph(unsigned char c, const bool *pixels);
+	/*
+	 * The rows of the glyph of c, or nullptr if it has none.
+	 */
+	const uint32_t *glyph(unsigned char c) const {
+		return glyph_indices[c] == NO_GLYPH ? nullptr : &rows[glyph_indices[c] * size.h];
+	}
+	/*
+	 * The area text takes when drawn by Framebuffer::draw_text() at scale.
+	 */
+	Area text_size(std::string_view text, uint_type scale = 1) const;
+private:
+	static constexpr uint16_t NO_GLYPH = UINT16_MAX;
+
+	Area size;
+	std::vector<uint32_t> rows;
+	std::array<uint16_t, 256> glyph_indices;
+};
+
+struct PixelFunctions; // How to draw in the pixel format of the device, see framebuffer_utils.cpp
+
+/*
+ * Pixels already converted to the pixel format of a framebuffer by Framebuffer::convert(),
+ * so that drawing them again is a copy of each row.
+ */
+struct NativeImage {
+	Area size{0, 0};
+	std::vector<uint8_t> pixels; // Row by row, with no padding
+	const PixelFunctions *format = nullptr;
+};
+
+class TiledRenderer; // Draws recorded fills and blits in parallel, see framebuffer_utils.cpp
+
 /*
  * O-------------> x
  * |
@@ -33,16 +126,58 @@ private:
 	bool if_blend;
 	bool if_nobuffer;
 	bool m_valid;
+	bool if_flipping; // buffer is the hidden page of video memory, and update() pans to it
+	bool if_vsync; // Whether FBIO_WAITFORVSYNC works
 
 	int fbfd;
 	unsigned char *data, *buffer;
+	unsigned char *front; // The pixels on display, data unless flipping
+	fb_var_screeninfo var_info;
+	decltype(std::declval<fb_var_screeninfo>().yres_virtual) original_yres_virtual;
 	Area fbsize;
 	decltype(std::declval<fb_fix_screeninfo>().smem_len) smem_len;
 	decltype(std::declval<fb_var_screeninfo>().bits_per_pixel) bytes_per_pixel;
 	decltype(std::declval<fb_fix_screeninfo>().line_length) line_length;
+	const PixelFunctions *pixel_functions; // Chosen once, so that drawing never branches on the format
+	TiledRenderer *tiled; // In tiled mode only
+
+	/*
+	 * The columns of each row drawn since the last update() or reset_buffer(), as [begin, end).
+	 * Empty in nobuffer mode, where there's nothing to copy.
+	 */
+	struct DirtySpan {uint_type begin, end;};
+	std::vector<DirtySpan> dirty;
+	void mark_dirty(UCoord pos, Area a);
+	bool clip(UCoord pos, Area &a) const;
+
+	void fill_area(UCoord pos, Area a, uint32_t value, bool blend);
+	void fill_or_record(UCoord pos, Area a, uint32_t value, bool blend);
+	template<typename Outer, typename Inner>
+	void fill_rows_between(double top, double bottom, Outer outer, Inner inner, Color c);
+	void draw_line_runs(UCoord from, UCoord to, uint32_t value, bool blend, bool skip_first, bool skip_last);
+
+	void set_up_buffer(bool nobuffer);
+	void flush() const;
+
+	bool start_flipping(fb_var_screeninfo &vinfo, fb_fix_screeninfo &finfo);
+	bool flip();
+	void end_flipping();
 public:
-	Framebuffer() : if_blend(false), if_nobuffer(false), m_valid(false), fbfd(0), data(nullptr), buffer(nullptr) {}
+	Framebuffer() :
+		if_blend(false), if_nobuffer(false), m_valid(false), if_flipping(false), if_vsync(false),
+		fbfd(0), data(nullptr), buffer(nullptr), front(nullptr), var_info{}, original_yres_virtual(0), pixel_functions(nullptr), tiled(nullptr) {}
+	/*
+	 * Unless nobuffer, drawing goes to a buffer that update() shows. Where the driver can pan over
+	 * two pages of video memory, the buffer is the hidden page and update() flips to it without copying
+	 * nor tearing. Otherwise it's in memory and update() copies it.
+	 */
 	Framebuffer(std::string_view device_name, bool nobuffer = false);
+	/*
+	 * An offscreen framebuffer of size in 32-bit XRGB, with the same drawing as on a device, for tests and
+	 * benchmarks where there's none. Its pixels are in anonymous memory, or mapped from file_name, which is
+	 * created or resized as needed and keeps what was shown last.
+	 */
+	static Framebuffer offscreen(Area size, std::string_view file_name = {}, bool nobuffer = false);
 	Framebuffer(const Framebuffer &) = delete;
 	Framebuffer(Framebuffer &&);
 	~Framebuffer();
@@ -50,20 +185,201 @@ public:
 	Framebuffer &operator=(Framebuffer &&) &;
 	bool valid() const {return m_valid;}
 	bool nobuffer() const {return if_nobuffer;}
+	bool page_flipping() const {return if_flipping;}
+	/*
+	 * Whether FBIO_WAITFORVSYNC works, as far as known. When flipping, update() waits for the vertical blank itself.
+	 */
+	bool vsync() const {return if_vsync;}
+	/*
+	 * Wait for the next vertical blank of the display. Return false right away where the driver can't.
+	 */
+	bool wait_for_vsync();
+	/*
+	 * Frames per second of the video mode, from its pixel clock and margins, or 0 where it's unknown, as offscreen.
+	 */
+	double refresh_rate() const;
 	void set_blend_mode(bool if_blend) {this->if_blend = if_blend;}
 	bool get_blend_mode() const {return if_blend;}
 	Area size() const;
 	Color get(UCoord pos) const;
 
+	/*
+	 * Show what has been drawn since the last call, by flipping the pages or copying.
+	 */
 	void update();
+	/*
+	 * Discard what has been drawn since the last update(), by copying it back from the device.
+	 */
 	void reset_buffer();
+	/*
+	 * Regard the whole buffer as drawn, e.g. after something else has drawn on the device,
+	 * so that the next update() or reset_buffer() copies all of it.
+	 */
+	void invalidate();
+
+	/*
+	 * In tiled mode, fills, rectangles and blits are recorded instead of drawn. The screen is cut into tiles,
+	 * and render() draws what was recorded over each of them, on threads threads at once, the calling one
+	 * included. The pixels are the same as those drawn right away. Whatever else draws or reads pixels,
+	 * update() included, renders first, and reset_buffer() discards what was recorded unless nobuffer.
+	 * Images given to blit() must stay alive and unchanged until they're rendered.
+	 * threads == 0 leaves tiled mode.
+	 */
+	void set_tiled(unsigned threads);
+	bool tiled_mode() const {return tiled != nullptr;}
+	void render();
+
+	/*
+	 * What has been drawn, shown or not yet, in the layout of Image.
+	 */
+	Image snapshot() const;
+	/*
+	 * Write snapshot() to a binary PPM (P6) or to a PNG file, without alpha.
+	 * PNG is written uncompressed, so that no library is needed.
+	 */
+	void dump_ppm(std::string_view file_name) const;
+	void dump_png(std::string_view file_name) const;
 
 	void set(UCoord pos, Color c);
 	void fill(Color c);
 	void draw_rectangle(UCoord, Area, Color);
+	/*
+	 * Fill length pixels to the right of pos. Like every primitive, it's clipped at the edges.
+	 */
+	void fill_span(UCoord pos, uint_type length, Color c);
 	void fill_rectangle(UCoord, Area, Color);
+	/*
+	 * Draw image with its top left corner at pos, a row at a time.
+	 * The blend mode of the framebuffer doesn't apply.
+	 */
+	void blit(const Image &image, UCoord pos, BlendMode mode = BlendMode::ALPHA);
+	/*
+	 * Draw image stretched to fill dest, like blit(). The rows are scaled straight onto the framebuffer,
+	 * on several threads when there are many of them.
+	 */
+	void blit_scaled(const Image &image, URect dest, ScaleFilter filter = ScaleFilter::BILINEAR, BlendMode mode = BlendMode::ALPHA);
+	/*
+	 * image scaled to size and converted to the pixel format of this framebuffer, to be drawn by blit()
+	 * as often as needed, as blit() draws in BlendMode::REPLACE.
+	 */
+	NativeImage convert(const Image &image, Area size, ScaleFilter filter = ScaleFilter::BILINEAR) const;
+	NativeImage convert(const Image &image) const {return convert(image, image.size, ScaleFilter::NEAREST);}
+	/*
+	 * Whether image was converted to the pixel format of this framebuffer, so that blit() can draw it.
+	 */
+	bool compatible(const NativeImage &image) const {return image.format == pixel_functions;}
+	void blit(const NativeImage &image, UCoord pos);
+	/*
+	 * Draw a line with Bresenham's algorithm, a span at a time.
+	 */
 	void draw_line(UCoord, UCoord, Color);
+	void draw_lines(const std::vector<std::pair<UCoord, UCoord>> &lines, Color c);
+	/*
+	 * Draw lines through points, each point once. If closed, the last point is joined to the first one.
+	 */
+	void draw_polyline(const std::vector<UCoord> &points, Color c, bool closed = false);
+	/*
+	 * Draw a line with Xiaolin Wu's algorithm, blending the pixels on both sides by how close they are to it,
+	 * whatever the blend mode.
+	 */
+	void draw_line_antialiased(UCoord, UCoord, Color);
+	/*
+	 * Fill the pixels whose centers are inside the polygon through points, by the nonzero winding rule,
+	 * a span at a time from an active edge table. Edges are exact to 1/256 of a pixel, so that polygons
+	 * sharing an edge neither overlap nor leave a gap between them.
+	 */
+	void fill_polygon(const std::vector<Point> &points, Color c);
+	/*
+	 * Fill the pixels whose centers are inside the ellipse, or those of its outline, thickness pixels inward.
+	 */
+	void fill_ellipse(Point center, double radius_x, double radius_y, Color c);
+	void draw_ellipse(Point center, double radius_x, double radius_y, Color c, double thickness = 1);
+	void fill_circle(Point center, double radius, Color c) {fill_ellipse(center, radius, radius, c);}
+	void draw_circle(Point center, double radius, Color c, double thickness = 1) {
+		draw_ellipse(center, radius, radius, c, thickness);
+	}
+	/*
+	 * The same for the rectangle from top_left to bottom_right, with its corners rounded by radius.
+	 */
+	void fill_rounded_rectangle(Point top_left, Point bottom_right, double radius, Color c);
+	void draw_rounded_rectangle(Point top_left, Point bottom_right, double radius, Color c, double thickness = 1);
+	/*
+	 * Draw text with its top left corner at pos, each pixel of the font as a square of scale pixels.
+	 * '\n' starts a new line, and characters without a glyph are left blank.
+	 * Only the pixels of the glyphs are drawn. Return the area of the text, as font.text_size() does.
+	 */
+	Area draw_text(const BitmapFont &font, UCoord pos, std::string_view text, Color c, uint_type scale = 1);
 };
 
+/*
+ * Shows the frames of a program drawing on a Framebuffer once per refresh of the display, sleeping in between.
+ * Frames are paced by FBIO_WAITFORVSYNC where the driver supports it, and otherwise by a timerfd at the refresh
+ * rate of the video mode, or DEFAULT_REFRESH_RATE where that's unknown. Frames that take longer than a period
+ * are counted as missed. Under vsync they wait for the next vertical blank; paced by the timer, they're shown
+ * right away and push back the following ones instead of hurrying to catch up.
+ *
+ * Usage:
+ * 	FrameScheduler scheduler(fb);
+ * 	scheduler.run([&](uint64_t frame) {
+ * 		... // Draw
+ * 		return !quit;
+ * 	});
+ */
+class FrameScheduler {
+public:
+	enum class Mode : uint8_t {
+		VSYNC, // Synchronize with the display, or run at its refresh rate if vsync is unavailable.
+		TARGET_FPS
+	};
+	constexpr static double DEFAULT_REFRESH_RATE = 60;
+
+	/*
+	 * In Mode::VSYNC, this waits for a vertical blank to see whether the driver supports it.
+	 * Throw FramebufferError if no timer can be made.
+	 */
+	FrameScheduler(Framebuffer &fb, Mode mode = Mode::VSYNC, double target_fps = DEFAULT_REFRESH_RATE);
+	FrameScheduler(const FrameScheduler &) = delete;
+	FrameScheduler &operator=(const FrameScheduler &) = delete;
+	~FrameScheduler();
+
+	/*
+	 * Call draw(frame) and show what it drew on the next refresh, until it returns false.
+	 * What's drawn by the call returning false isn't shown.
+	 */
+	template<typename Function>
+	void run(Function draw) {
+		while(draw(m_frames)) present();
+	}
+	/*
+	 * Wait until the next frame is due, and show what has been drawn with update().
+	 */
+	void present();
+
+	bool vsync() const {return timerfd < 0;}
+	/*
+	 * Time between two frames in milliseconds, as measured under vsync if the video mode doesn't tell.
+	 */
+	double frame_period() const {return period * 1000;}
+	uint64_t frames() const {return m_frames;}
+	/*
+	 * Periods that passed without a frame being shown.
+	 */
+	uint64_t missed() const {return m_missed;}
+private:
+	void start_timer(double fps);
+	bool arm_timer();
+
+	Framebuffer &fb;
+	int timerfd; // -1 under vsync
+	double period; // In seconds, 0 until known
+	double last_shown; // In seconds of CLOCK_MONOTONIC, under vsync
+	uint64_t m_frames, m_missed;
+};
+
+// After all of the above, which it builds on
+#ifdef INCLUDE_IMAGE_LOADER
+#include <image_loader.h>
+#endif
+
 #endif
 #endif
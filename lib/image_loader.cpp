@@ -0,0 +1,61 @@
+#ifndef __WIN32
+#include "image_loader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define STB_IMAGE_STATIC // Its functions stay in this file, apart from those of programs using it too
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+using std::string_view;
+
+ImageCache::Decoded &ImageCache::decoded(string_view file_name) {
+	if(const auto found = files.find(file_name); found != files.end()) return found->second;
+
+	const std::string name(file_name);
+	int w, h, channels;
+	uint8_t *bytes = stbi_load(name.c_str(), &w, &h, &channels, 4);
+	if(!bytes) {
+		throw ImageError(name + ": " + stbi_failure_reason());
+	}
+	Decoded result{Image({uint_type(w), uint_type(h)}), true, ScaleFilter::NEAREST, {}, {}};
+	for(size_t i = 0; i < result.image.pixels.size(); ++i) {
+		const uint8_t *rgba = bytes + 4 * i;
+		result.image.pixels[i] = uint32_t(rgba[3]) << 24 | uint32_t(rgba[0]) << 16 | uint32_t(rgba[1]) << 8 | rgba[2];
+		result.opaque = result.opaque && rgba[3] == 255;
+	}
+	stbi_image_free(bytes);
+	return files.emplace(name, std::move(result)).first->second;
+}
+
+const Image &ImageCache::load(string_view file_name) {
+	return decoded(file_name).image;
+}
+
+void ImageCache::draw(Framebuffer &fb, string_view file_name, URect dest, ScaleFilter filter) {
+	Decoded &file = decoded(file_name);
+	const Area size = dest.area;
+	if(!file.opaque) {
+		if(file.scaled.size.w != size.w || file.scaled.size.h != size.h || file.filter != filter) {
+			file.scaled = file.image.scaled(size, filter);
+			file.filter = filter;
+		}
+		fb.blit(file.scaled, dest.coord, BlendMode::ALPHA);
+		// blit() only records the pixels in tiled mode, and they may be replaced or cleared before they're rendered
+		if(fb.tiled_mode()) fb.render();
+		return;
+	}
+	// Converted again for another size, or a framebuffer of another format
+	if(file.native.size.w != size.w || file.native.size.h != size.h || file.filter != filter || !fb.compatible(file.native)) {
+		file.native = fb.convert(file.image, size, filter);
+		file.filter = filter;
+	}
+	fb.blit(file.native, dest.coord);
+}
+
+void ImageCache::clear() {
+	files.clear();
+}
+
+#endif
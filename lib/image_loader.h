@@ -0,0 +1,69 @@
+#ifndef __WIN32
+#ifndef __IMAGE_LOADER_H__
+#define __IMAGE_LOADER_H__
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <framebuffer_utils.h>
+
+/*
+ * Included by framebuffer_utils.h, so INCLUDE_FRAMEBUFFER is needed too, and stb_image.h where it can be included.
+ */
+class ImageError : std::exception {
+	friend class ImageCache;
+public:
+	virtual const char *what() const noexcept override {return msg.c_str();}
+private:
+	ImageError(std::string_view msg_) : std::exception(), msg(msg_) {}
+
+	std::string msg;
+};
+
+/*
+ * Image files, PNG, JPEG or any other that stb_image reads, decoded once, and kept at the size
+ * they were last drawn at, converted to the pixel format of the framebuffer. Drawing one again is then
+ * a copy of its rows, as for a wallpaper redrawn every frame, while drawing it at another size replaces
+ * what was kept. Translucent images are kept scaled instead, and blended over what's below.
+ *
+ * Usage:
+ * 	ImageCache images;
+ * 	while(...) {
+ * 		images.draw(fb, "res/background.png", {{0, 0}, fb.size()});
+ * 		... // Draw over it
+ * 		fb.update();
+ * 	}
+ */
+class ImageCache {
+public:
+	/*
+	 * The pixels of file_name. Throw ImageError if it can't be read or decoded.
+	 */
+	const Image &load(std::string_view file_name);
+	/*
+	 * Draw file_name on fb, stretched to fill dest. In tiled mode, fb renders it right away,
+	 * so that no pixels kept here are left recorded for later.
+	 */
+	void draw(Framebuffer &fb, std::string_view file_name, URect dest, ScaleFilter filter = ScaleFilter::BILINEAR);
+	/*
+	 * Forget every image, decoded or scaled.
+	 */
+	void clear();
+private:
+	struct Decoded {
+		Image image;
+		bool opaque;
+
+		// As last drawn
+		ScaleFilter filter;
+		NativeImage native; // If opaque
+		Image scaled; // Otherwise
+	};
+
+	Decoded &decoded(std::string_view file_name);
+
+	std::map<std::string, Decoded, std::less<>> files;
+};
+
+#endif
+#endif
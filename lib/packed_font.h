@@ -0,0 +1,74 @@
+#ifndef __PACKED_FONT_H__
+#define __PACKED_FONT_H__
+
+#include <utils.h>
+
+/*
+ * A 14x14 bitmap font with the characters from '!' to '~', except for the lowercase letters.
+ * Each pixel occupies 1 bit, row by row and character by character. Each letter from 'A' to 'P'
+ * holds 4 of the bits as its distance from 'A', the first pixel in the highest bit.
+ */
+constexpr Area PACKED_FONT_CHARACTER_SIZE = {14, 14};
+inline constexpr char PACKED_FONT_DATA[] =
+	"AHAABMAAHAABMAAHAABMAAHAABMAAHAAAAAAAAABMAAHAABMAAAAADJMAOHADJMA"
+	"OHAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADDAAMMAGGAPPPDPPMDDAAMMAGGAPP"
+	"PDPPMBJIAMMADDAAMMAADAAHPMDPPBPPMHDABPPADPOAHPMADDIAMODPPIPPMDPO"
+	"AAMADIAFPADGMBJLAMGMGBPDADJIAAMOAGHMDBLBIGMMBLGAHNAAOBPIAPPAHPMB"
+	"MHAHBIAMMABPGAPNIHDOBMHAHPOBPPIDMGAGAABMAAHAABMAAHAAAAAAAAAAAAAA"
+	"AAAAAAAAAAAAAAAAAAAAAAAAAOAAHIADIAAMAAHAABMAAHAABMAAHAABMAAHAAAO"
+	"AABOAADIBMAAHIAAHAAAMAADIAAOAADIAAOAADIAAOAADIABMABOAAHAAAAAAAAA"
+	"AAAAAOAADIAAOADPPIPPOAHMADLIBMHAOAMDABAAAAAAAAAAAAAAABMAAHAABMAA"
+	"HAAPPMDPPABMAAHAABMAAHAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAO"
+	"AADIABOAAHIAAAAAAAAAAAAAAAAAAAAAAAAAAPPMDPPAAAAAAAAAAAAAAAAAAAAA"
+	"AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAADMAAPAADMAABOAAHIABOAAHIADOA"
+	"APIADIAAOAAPIADOAAPAADMAAPAADMAAPMADPADAPAMDMPADPMAPPADPMAPPADPM"
+	"APDMDAPAMAPMADPAADMAAPAAPMADPAADMAAPAADMAAPAADMAAPAADMAAPADPPMPP"
+	"PDPPAPPMPADPMAPAAPMADPAPPADPMDPMAPPAPMADPAAPPPPPPPDPPMPPPAAPAADM"
+	"ADMAAPAAPPADPMAADMAAPDADMMAPDPPAPPMADPAAPMAPPADPMDMPAPDMPAPDMDMP"
+	"PPPPPPAAPAADMAAPAADMPPPDPPMPAADMAAPPPDPPMAADMAAPAADMAAPPADPMAPDP"
+	"PAPPMAPMADPADMAAPAAPAADMAAPPPDPPMPADPMAPPADPMAPDPPAPPMPPPPPPPPAD"
+	"PMAPAAPAADMADMAAPAAPAADMAAPAADMAAPAADMADPMAPPAPADDMAMPMDDPAMDPMA"
+	"PPAMDPPAPPMADPAAPDPPAPPMDPPAPPMPADPMAPPADPMAPDPPMPPPAADMAAPAAPAA"
+	"DMDPMAPPAAAAAAAAAAAAHAABMAAHAAAAAAAAABMAAHAABMAAAAAAAAAAAAAAAAAA"
+	"AAAAAHAABMAAHAAAAAAAAABMAAPAADMAAPAAAAAAAAAAAAAAAAABOAAPAAHAADIA"
+	"BMAAOAABMAADIAAHAAAPAABOAAAAAAAAAAAAAAAAAABPOAHPIAAAAAAABPOAHPIA"
+	"AAAAAAAAAAAAAAAAAAAABOAADMAADIAAHAAAOAABMAAOAAHAADIADMABOAAAAAAA"
+	"AABOAAPMAHBIBIGAEBIAAOAAHAADIAAMAADAAAAAADAAAMAAAAABPAAPOAHAMDJP"
+	"JMMGHDBJMMGHBPAOAABOBIDPMAHOAAAAAPMADPADMPAPDMPADPMAPPADPMAPPPPP"
+	"PPPPADPMAPPADPMAPPPPDPPMPADPMAPPADPMAPPPPDPPMPADPMAPPADPMAPPPPDP"
+	"PMAPPADPMDMDMPAPPAADMAAPAADMAAPAADMAADMDMPAPAPPADPMPPMDPPAPAPDMD"
+	"MPADPMAPPADPMAPPADPMAPPAPDMDMPPMDPPADPPMPPPDMAAPAADMAAPAADPPAPPM"
+	"DMAAPAADMAAPAADPPMPPPPPPPPPPPAADMAAPAADMAAPPPDPPMPAADMAAPAADMAAP"
+	"AADMAAAPPMDPPDMAAPAAPAADMAAPAPPMDPPADPMAPDMDMPAPAPPMDPPPADPMAPPA"
+	"DPMAPPADPMAPPPPPPPPPADPMAPPADPMAPPADPMAPDPPMPPPADMAAPAADMAAPAADM"
+	"AAPAADMAAPAADMAAPADPPMPPPDPPMPPPADMAAPAADMAAPAADMAAPAADMAAPADDMA"
+	"MPADPAAPMAPADPMAPPAPDMDMPDMDMPAPPADPMAPPMDPPAPDPDMPMPAPPMDPDMAAP"
+	"AADMAAPAADMAAPAADMAAPAADMAAPAADMAAPAADPPMPPPPADPMAPPMPPPDPPPPPPP"
+	"PPPPPPPPPDDPMMPPADPMAPPADPMAPPADPMAPPMDPPAPPPDPPMPPPPPPPPPDPPMPP"
+	"PAPPMDPPADPMAPDPPAPPMPADPMAPPADPMAPPADPMAPPADPMAPPADPMAPDPPAPPMP"
+	"PPDPPMPADPMAPPADPMAPPADPMAPPPPDPPMPAADMAAPAADMAADPMAPPAPADPMAPPA"
+	"DPMAPPADPMAPPADPMAPDPPAPPMAADMAAPPPPDPPMPADPMAPPADPMAPPAPPMDPPPM"
+	"DPPAPDPDMPMPAPPMDPDPMAPPAPAPDMDMPAADMAADPPAPPMAADMAAPPADPMAPDPPA"
+	"PPMDPPMPPPADMAAPAADMAAPAADMAAPAADMAAPAADMAAPAADMAAPAPADPMAPPADPM"
+	"APPADPMAPPADPMAPPADPMAPPADPMAPDPPAPPMPADPMAPPADPMAPPADPMAPPMPPPD"
+	"PDPPAPPMAPMADPAADAAAMAPADPMAPPADPMAPPDDPMMPPPPPPPPPPPPPPPPMPPPDP"
+	"PADPMAPPADPMAPDMPAPDMAPMADPAAPMADPADMPAPDMPADPMAPMAAPAADDMDMPAPD"
+	"MDMPAPDMDMPAPAPPADPMADMAAPAADMAAPAADMAAPADPPMPPPAADMAAPAAPAADMAD"
+	"MAAPAAPAADMADMAAPAADPPMPPPAAAAAHMABPAAGAABIAAGAABIAAGAABIAAGAABI"
+	"AAHMABPAAAAAPAADMAAPAADMAAPIADOAADIAAOAADOAAPIABOAAHIABOAAHIAAAA"
+	"PIADOAABIAAGAABIAAGAABIAAGAABIAAGAAPIADOAAAAAAAAAAMAAHIADDABIGAM"
+	"AMGABIAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+	"AAAAAPPMDPPAAAAAAAABIAAHAABOAADIAAGAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+	"AAAAABOAAPIADIAAOAADIABOAAHIAAOAADIAAOAADOAAHIAAAADAAAMAADAAAMAA"
+	"DAAAMAADAAAMAADAAAMAADAAAMAADAAAMAAAABOAAHMAAHAABMAAHAABOAAHIABM"
+	"AAHAABMABPAAHIAAAAAAAAADIEBPDAMPICBMAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+	"AAAA";
+
+/*
+ * The index of c among the characters of PACKED_FONT_DATA, which c must be one of.
+ */
+constexpr size_t packed_font_index(char c) {
+	return c < 'a' ? c - '!' : c - 26 - '!';
+}
+
+#endif
@@ -106,6 +106,45 @@ char32_t utf8to32(const char *src, int *output_length) {
 	return utf8to32((const unsigned char *)src, output_length);
 }
 
+int utf32to8(char32_t c, char *dst) {
+	if(c < 0x80) {
+		dst[0] = c;
+		return 1;
+	} else if(c < 0x800) {
+		dst[0] = 0xc0 | (c >> 6);
+		dst[1] = 0x80 | (c & 0x3f);
+		return 2;
+	} else if(c < 0x10000) {
+		dst[0] = 0xe0 | (c >> 12);
+		dst[1] = 0x80 | ((c >> 6) & 0x3f);
+		dst[2] = 0x80 | (c & 0x3f);
+		return 3;
+	}
+	dst[0] = 0xf0 | (c >> 18);
+	dst[1] = 0x80 | ((c >> 12) & 0x3f);
+	dst[2] = 0x80 | ((c >> 6) & 0x3f);
+	dst[3] = 0x80 | (c & 0x3f);
+	return 4;
+}
+
+#ifndef __WIN32
+RawMode::RawMode() {
+	m_valid = tcgetattr(STDIN_FILENO, &old_settings) == 0;
+	if(m_valid) {
+		termios settings = old_settings;
+		settings.c_lflag &= ~(ECHO | ICANON);
+		settings.c_cc[VMIN] = 1;
+		settings.c_cc[VTIME] = 0;
+		tcsetattr(STDIN_FILENO, TCSANOW, &settings);
+	}
+	++depth;
+}
+RawMode::~RawMode() {
+	--depth;
+	if(m_valid) tcsetattr(STDIN_FILENO, TCSANOW, &old_settings);
+}
+#endif
+
 std::string demangle(const std::type_info &info) {
 	char *p = abi::__cxa_demangle(info.name(), nullptr ,nullptr, nullptr);
 	std::string ret(p);
@@ -122,3 +161,11 @@ std::string demangle(const std::type_info &info) {
 #ifdef INCLUDE_ARGUMENT
 #include "argument_utils.cpp"
 #endif
+
+#ifdef INCLUDE_FRAME_PACER
+#include "frame_pacer.cpp"
+#endif
+
+#ifdef INCLUDE_IMAGE_LOADER
+#include "image_loader.cpp"
+#endif
@@ -6,6 +6,10 @@
 #include <framebuffer_utils.h>
 #endif
 
+#ifdef INCLUDE_FRAME_PACER
+#include <frame_pacer.h>
+#endif
+
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
@@ -15,6 +19,11 @@ int parse_int(const char *str, bool *success = nullptr);
 
 char32_t utf8to32(const unsigned char *src, int *output_length = nullptr);
 char32_t utf8to32(const char *src, int *output_length = nullptr);
+/*
+ * Encode a character into dst, which should have room for 4 bytes.
+ * Return the amount of bytes written.
+ */
+int utf32to8(char32_t c, char *dst);
 
 #include <string>
 #include <typeinfo>
@@ -24,11 +33,37 @@ std::string demangle(const std::type_info &info);
 #include <conio.h>
 template<typename T>
 int getch(const T &) {return getch();}
+/*
+ * The console of Windows is read without echo by getch() anyway.
+ */
+class RawMode {
+public:
+	static bool active() {return true;}
+};
 #else
 #include <termios.h>
 #include <unistd.h>
+/*
+ * Turn off echo and line buffering of the terminal for the lifetime of the object,
+ * with a single tcsetattr() on each end instead of two per character.
+ * getch() leaves the terminal settings alone while one exists.
+ */
+class RawMode {
+public:
+	RawMode();
+	~RawMode();
+	RawMode(const RawMode &) = delete;
+	RawMode &operator=(const RawMode &) = delete;
+
+	static bool active() {return depth != 0;}
+private:
+	inline static unsigned depth = 0;
+	termios old_settings;
+	bool m_valid;
+};
 template<typename Callable_t>
 char getch(const Callable_t &charget) {
+	if(RawMode::active()) return charget();
 	termios oldt, newt;
 	tcgetattr(STDIN_FILENO, &oldt);
 	newt = oldt;